@@ -0,0 +1,73 @@
+#!/bin/bash
+# Compares the order of the getdents64 syscall with the inode order (-I) of the myls and the mycp on the given directory.
+# The myls must print the same listing and the mycp must make the same copy in both orders, and the best of the repeated runs is reported.
+#
+#   usage: bench/inode_order.sh DIRECTORY [DESTINATION_PARENT]
+#
+# The page cache is dropped before each run (needs root), so that the inodes are read from the storage.
+# Set COLD=0 to keep the cache, and REPEAT to change the number of runs of each setting (3 by default).
+# The copies are made in a temporary directory in DESTINATION_PARENT (/tmp by default), which is removed after each run.
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 DIRECTORY [DESTINATION_PARENT]" >&2
+    exit 1
+fi
+
+dir=$1
+parent=${2:-/tmp}
+repeat=${REPEAT:-3}
+root=$(cd "$(dirname "$0")/.." && pwd)
+bin=$(mktemp -d)
+expected=$(mktemp)
+actual=$(mktemp)
+copy=$(mktemp -d "$parent/inode_order.XXXXXX")
+trap 'rm -rf "$bin" "$expected" "$actual" "$copy"' EXIT
+
+gcc -O2 "$root/myls.c" -o "$bin/myls"
+gcc -O2 "$root/mycp.c" -o "$bin/mycp"
+
+# prints the best wall time (in nanoseconds) of the given command
+run() {
+    local best=""
+    for _ in $(seq "$repeat"); do
+        rm -rf "$copy" && mkdir "$copy"
+        if [ "${COLD:-1}" = 1 ]; then
+            sync
+            echo 3 > /proc/sys/vm/drop_caches
+        fi
+        local start=$(date +%s%N)
+        "$@" > "$actual"
+        local elapsed=$(( $(date +%s%N) - start ))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    echo "$best"
+}
+
+# prints a line of the table, with the speedup of the inode order
+report() {
+    printf "%-6s %12.3f %12.3f %8s\n" "$1" "$(echo "$2" | awk '{print $1 / 1e9}')" "$(echo "$3" | awk '{print $1 / 1e9}')" \
+        "$(awk -v s="$2" -v p="$3" 'BEGIN {printf "%.2fx", s / p}')"
+}
+
+printf "%-6s %12s %12s %8s   (%d entries)\n" "tool" "getdents64" "inode (-I)" "speedup" "$(ls -f "$dir" | wc -l)"
+
+plain=$(run "$bin/myls" "$dir")
+cp "$actual" "$expected"
+sorted=$(run "$bin/myls" -I "$dir")
+if ! cmp -s "$expected" "$actual"; then
+    echo "myls -I printed a different listing" >&2
+    exit 1
+fi
+report myls "$plain" "$sorted"
+
+plain=$(run "$bin/mycp" "$dir" "$copy")
+sorted=$(run "$bin/mycp" -I "$dir" "$copy")
+if ! diff -r --no-dereference "$dir" "$copy" > /dev/null; then
+    echo "mycp -I made a different copy" >&2
+    exit 1
+fi
+report mycp "$plain" "$sorted"
@@ -0,0 +1,61 @@
+#!/bin/bash
+# Compares the serial stat path of the myls with the parallel stat (-P N) on the given directory.
+# Every run must print the same listing, and the best of the repeated runs is reported.
+#
+#   usage: bench/parallel_stat.sh DIRECTORY [WORKERS...]
+#
+# Set COLD=1 to drop the page cache before each run (needs root), so that the inodes are read from the storage.
+# Set REPEAT to change the number of runs of each setting (3 by default).
+
+set -e
+
+if [ $# -lt 1 ]; then
+    echo "usage: $0 DIRECTORY [WORKERS...]" >&2
+    exit 1
+fi
+
+dir=$1
+shift
+workers=${*:-"2 4 8 16"}
+repeat=${REPEAT:-3}
+root=$(cd "$(dirname "$0")/.." && pwd)
+myls=$(mktemp)
+expected=$(mktemp)
+actual=$(mktemp)
+trap 'rm -f "$myls" "$expected" "$actual"' EXIT
+
+gcc -O2 "$root/myls.c" -o "$myls"
+
+# prints the best wall time (in seconds) of the myls with the given options
+run() {
+    local best=""
+    for _ in $(seq "$repeat"); do
+        if [ "${COLD:-0}" = 1 ]; then
+            sync
+            echo 3 > /proc/sys/vm/drop_caches
+        fi
+        local start=$(date +%s%N)
+        "$myls" "$@" "$dir" > "$actual"
+        local elapsed=$(( $(date +%s%N) - start ))
+        if [ -z "$best" ] || [ "$elapsed" -lt "$best" ]; then
+            best=$elapsed
+        fi
+    done
+    echo "$best"
+}
+
+serial=$(run)
+cp "$actual" "$expected"
+entries=$(wc -l < "$expected")
+printf "%-10s %10s %8s   (%d entries)\n" "mode" "seconds" "speedup" "$entries"
+printf "%-10s %10.3f %8s\n" "serial" "$(echo "$serial" | awk '{print $1 / 1e9}')" "1.00x"
+
+for n in $workers; do
+    parallel=$(run -P "$n")
+    if ! cmp -s "$expected" "$actual"; then
+        echo "-P $n printed a different listing" >&2
+        exit 1
+    fi
+    printf "%-10s %10.3f %8s\n" "-P $n" "$(echo "$parallel" | awk '{print $1 / 1e9}')" \
+        "$(awk -v s="$serial" -v p="$parallel" 'BEGIN {printf "%.2fx", s / p}')"
+done
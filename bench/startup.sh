@@ -0,0 +1,57 @@
+#!/bin/bash
+# Compares the startup latency of the dynamic build (linked with the glibc) and the freestanding build (-DFREESTANDING
+# -nostdlib -static) of the myls, the mycp and the mycat, by running each tool many times on a tiny input.
+# Both builds must print the same output, and the mean time of a run (including the fork and the exec) is reported.
+#
+#   usage: bench/startup.sh [RUNS]
+#
+# RUNS is the number of runs of each binary (1000 by default). The inputs are made in a temporary directory.
+
+set -e
+
+runs=${1:-1000}
+root=$(cd "$(dirname "$0")/.." && pwd)
+bin=$(mktemp -d)
+work=$(mktemp -d)
+trap 'rm -rf "$bin" "$work"' EXIT
+
+for tool in myls mycp mycat; do
+    gcc -O2 "$root/$tool.c" -o "$bin/$tool.dynamic"
+    gcc -O2 -DFREESTANDING -nostdlib -static -fno-stack-protector "$root/$tool.c" -o "$bin/$tool.freestanding"
+done
+
+mkdir "$work/dir"
+echo "hello" > "$work/dir/file"
+
+# prints the mean wall time (in nanoseconds) of a run of the given command, whose output is dropped
+run() {
+    local start=$(date +%s%N)
+    for _ in $(seq "$runs"); do
+        "$@" > /dev/null 2>&1 || true
+    done
+    echo $(( ($(date +%s%N) - start) / runs ))
+}
+
+# prints a line of the table, with the speedup of the freestanding build
+report() {
+    printf "%-6s %12.1f %14.1f %8s\n" "$1" "$(echo "$2" | awk '{print $1 / 1e3}')" "$(echo "$3" | awk '{print $1 / 1e3}')" \
+        "$(awk -v d="$2" -v f="$3" 'BEGIN {printf "%.2fx", d / f}')"
+}
+
+# runs both builds of the tool with the given arguments, after checking that they print the same output
+compare() {
+    local tool=$1
+    shift
+    if ! cmp -s <("$bin/$tool.dynamic" "$@" 2>&1) <("$bin/$tool.freestanding" "$@" 2>&1); then
+        echo "the freestanding $tool printed a different output" >&2
+        exit 1
+    fi
+    report "$tool" "$(run "$bin/$tool.dynamic" "$@")" "$(run "$bin/$tool.freestanding" "$@")"
+}
+
+printf "%-6s %12s %14s %8s   (us per run, %d runs)\n" "tool" "dynamic" "freestanding" "speedup" "$runs"
+
+compare myls "$work/dir"
+compare mycat "$work/dir/file"
+rm -rf "$work/copy"
+compare mycp "$work/dir/file" "$work/copy"
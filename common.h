@@ -0,0 +1,566 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <time.h>
+#include <errno.h>
+#include <linux/sched.h>
+#include <linux/futex.h>
+#include "syscall.h"
+
+/*
+ * The helpers that are shared by the myls, the mycp and the mycat, on top of the system call layer of syscall.h:
+ * the string and number helpers, the output to the file descriptors, the buffer of the read/write loop,
+ * the spin lock and the worker threads, and the arena allocator with the custom heap of each tool.
+ *
+ * Every function is static inline, so each tool (a single translation unit) only keeps the helpers that it uses.
+ */
+
+/* The system call numbers of the shared helpers */
+#define SCHED_YIELD_SYSCALL 24 //to give the CPU to the other workers while waiting for a lock
+#define CLONE_SYSCALL 56       //to create the worker threads
+#define EXIT_SYSCALL 60        //to terminate the worker thread
+#define FUTEX_SYSCALL 202      //to put the idle workers to sleep, and to wait for the worker threads to exit
+
+/* The flags of the clone syscall for the worker threads, which share everything but the stack */
+#define THREAD_CLONE_FLAGS (CLONE_VM | CLONE_FS | CLONE_FILES | CLONE_SIGHAND | CLONE_THREAD | CLONE_SYSVSEM \
+                            | CLONE_PARENT_SETTID | CLONE_CHILD_CLEARTID)
+
+/* preprocessors for the buffer of the read/write loop */
+#define MIN_BUFFER_SIZE 65536   //64 KiB, used for pipes, terminals and small files
+#define MAX_BUFFER_SIZE 4194304 //4 MiB, large sequential copies do not get faster beyond this
+
+/* preprocessors for the custom malloc function */
+#define ARENA_CHUNK_SIZE 1048576  //1 MiB, the size of the first chunk of the arena
+#define ARENA_MAX_CHUNK 67108864  //64 MiB, the chunks stop doubling at this size
+#define ARENA_PAGE_SIZE 4096      //the huge allocations are rounded up to the page size
+#define ARENA_ALIGN 16            //every allocation is aligned to 16 bytes
+#define ARENA_HEADER_SIZE ((long) ((sizeof(struct arenaChunk) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1)))
+
+/* struct for the buffer of the read/write loop, which is reused across the files */
+struct ioBuffer {
+    char *data; //the pointer that points the mapped buffer
+    long size;  //the size of the mapped buffer
+    unsigned int digest; //the running CRC-32C of the data of the current file that passed through the buffer (the -V and -M options of the mycp)
+};
+
+/* struct for the header of each chunk of the arena, which is mapped with the mmap syscall */
+struct arenaChunk {
+    struct arenaChunk *prev; //pointer that points to the previous chunk of the arena
+    long size;               //the number of mapped bytes of this chunk (including this header)
+};
+
+/*
+ * struct for the arena allocator, which allocates the memory by moving the break of its newest chunk.
+ * When the chunk is full, a new chunk is chained to the arena instead of failing.
+ */
+struct arena {
+    struct arenaChunk *chunk; //the newest chunk
+    char *brkp;               //the break of the newest chunk
+    char *endp;               //the end of the newest chunk
+    struct arenaChunk *spare; //a released chunk, which is reused by the next growth
+    long used;                //the number of allocated bytes
+    long peak;                //the maximum of the used
+    long mapped;              //the number of mapped bytes (including the spare chunk)
+    long peakMapped;          //the maximum of the mapped
+};
+
+/* struct for the mark of the arena, which releases every allocation after it with the resetArena() */
+struct arenaMark {
+    struct arenaChunk *chunk; //the newest chunk at the mark
+    char *brkp;               //the break at the mark
+    long used;                //the number of allocated bytes at the mark
+};
+
+/* The custom heap of the tool, which is shared by its worker threads */
+static struct arena heap;
+static int heapLock = 0; //the spin lock of the custom heap
+
+/**
+ * The custom strlen function.
+ *
+ * @param str the string to check it's length
+ * @return the length of the string
+ */
+static inline int strlength(const char *str) {
+    int count = 0;
+
+    while (*str != '\0') { //iterate the while loop until it reaches to the terminator character
+        count += 1;
+        str += 1;
+    }
+
+    return count;
+}
+
+/**
+ * The aim of this function is to copy the string to the new string.
+ *
+ * @param str the pointer that points the new string
+ * @param s the pointer that points the string that contains the value that should be copied
+ * @param length the length of the string that should be copied
+ */
+static inline void strcopy(char *str, const char *s, int length) {
+    for (int i = 0; i < length; i++) {
+        *str = *s;
+        str += 1;
+        s += 1;
+    }
+}
+
+/**
+ * This function compares the two strings.
+ *
+ * @param str1 the pointer that points to the first string
+ * @param str2 the pointer that points to the second string
+ *
+ * @return Returns an integer less than, equal to, or greater than zero if str1 is found, 
+ *         respectively, to be less than, to match, or be greater than str2.
+ */
+static inline int strCompare(const char *str1, const char *str2) {
+    int i = 0;
+
+    while (str1[i] != '\0') {
+        if (str1[i] != str2[i]) {
+            break;
+        }
+        i += 1;
+    }
+
+    return ((unsigned char) str1[i] - (unsigned char) str2[i]); //the bytes are compared as unsigned, just like the strcmp
+}
+
+/**
+ * This function converts the given decimal string to a number.
+ *
+ * @param str the decimal string
+ * @return the number, or -1 if the given string is not a non-negative decimal number
+ */
+static inline long parseNumber(const char *str) {
+    long num = 0;
+
+    if (*str == '\0') {
+        return -1;
+    }
+
+    while (*str != '\0') {
+        if (*str < '0' || *str > '9' || num > 100000000) {
+            return -1;
+        }
+        num = num * 10 + (*str - '0');
+        str += 1;
+    }
+
+    return num;
+}
+
+/**
+ * This function converts the given non-negative number to the decimal string.
+ *
+ * @param num the number
+ * @param str the buffer (at least 21 bytes)
+ * @return the pointer to the string, which is stored at the end of the buffer
+ */
+static inline char *formatNumber(long num, char *str) {
+    char *p = str + 20;
+
+    *p = '\0';
+    do {
+        *--p = (char) ('0' + num % 10);
+        num /= 10;
+    } while (num > 0);
+
+    return p;
+}
+
+/**
+ * This function writes exactly len bytes of the given buffer, by retrying the write syscall after a short write.
+ * Unlike writeText(), the buffer may contain the zero bytes.
+ *
+ * @param handle for stdout, 2 for stderr, file handle from open() for files
+ * @param buf the bytes that should be written
+ * @param len the number of bytes to write
+ * @return Returns len on success. On error, -errno will be returned.
+ */
+static inline long writeBytes(long handle, const char *buf, long len) {
+    long written = 0;
+
+    while (written < len) {
+        long ret = writeFile(handle, buf + written, len - written);
+
+        if (ret < 0) {
+            if (ret == -EINTR) {
+                continue;
+            }
+            return ret;
+        }
+        written += ret;
+    }
+
+    return written;
+}
+
+/**
+ * This function prints out the given string.
+ *
+ * @param text the target text that should be printed out
+ * @param handle for stdout, 2 for stderr, file handle from open() for files
+ * @return ret Returns the number of bytes that were written. On error, -errno will be returned.
+ */
+static inline int writeText(const char *text, long handle) {
+    return writeBytes(handle, text, strlength(text));
+}
+
+/**
+ * Prints out the given text via stderr stream.
+ *
+ * @param text the error message
+ * @return If the write syscall success, returns 1. Otherwise, returns -1.
+ */
+static inline int printErr(const char *text) {
+    long l = 2; //2 for stderr
+    return writeText(text, l);
+}
+
+/**
+ * This function chooses the size of the buffer for the read/write loop from the size of the file.
+ * The buffer grows from MIN_BUFFER_SIZE by doubling until it covers the whole file or reaches MAX_BUFFER_SIZE.
+ *
+ * @param fileSize the size of the file (0 for pipes, terminals, etc)
+ * @return the size of the buffer
+ */
+static inline long chooseBufferSize(long fileSize) {
+    long size = MIN_BUFFER_SIZE;
+
+    while (size < fileSize && size < MAX_BUFFER_SIZE) {
+        size *= 2;
+    }
+
+    return size;
+}
+
+/**
+ * This function makes sure that the given buffer has at least the given number of bytes.
+ * The buffer only grows, so that the mapped memory is reused by the following files.
+ *
+ * @param buffer the buffer of the read/write loop
+ * @param size the required size of the buffer
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+static inline int reserveBuffer(struct ioBuffer *buffer, long size) {
+    if (buffer->size >= size) {
+        return 0;
+    }
+
+    long addr = mapMemory(size);
+
+    if (addr < 0) {
+        return (buffer->data != NULL) ? 0 : -1; //keep using the smaller buffer if there is one
+    }
+
+    if (buffer->data != NULL) {
+        unmapMemory(buffer->data, buffer->size);
+    }
+
+    buffer->data = (char *) addr;
+    buffer->size = size;
+    return 0;
+}
+
+/**
+ * This is a wrapper function of the sched_yield syscall.
+ */
+static inline void yieldCpu() {
+    syscall0(SCHED_YIELD_SYSCALL);
+}
+
+/**
+ * This function locks the given spin lock.
+ *
+ * @param lock the lock word
+ */
+static inline void spinLock(int *lock) {
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        yieldCpu(); //the lock is held only for a few instructions, so let the owner of the lock run
+    }
+}
+
+/**
+ * This function unlocks the given spin lock.
+ *
+ * @param lock the lock word
+ */
+static inline void spinUnlock(int *lock) {
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * This is a wrapper function of the futex syscall.
+ *
+ * @param addr the address of the futex word
+ * @param op the futex operation (i.e. FUTEX_WAIT_PRIVATE, FUTEX_WAKE_PRIVATE)
+ * @param val the expected value for the wait operations, or the number of waiters to wake
+ * @param timeout the relative timeout of the wait operations, or NULL to wait forever
+ * @return Depends on the operation. On error, -errno will be returned.
+ */
+static inline long futexCall(int *addr, long op, long val, struct timespec *timeout) {
+    return syscall4(FUTEX_SYSCALL, (long) addr, op, val, (long) timeout);
+}
+
+/**
+ * This function creates a thread with the clone syscall, which shares the memory and the file descriptors.
+ * The child thread starts on the given stack, calls fn(arg), and exits with the exit syscall.
+ * The kernel stores the thread id into the tid, and clears it (and wakes the futex) when the thread exits.
+ *
+ * The arguments are bound to the registers of the clone syscall like the syscallN() functions. The child thread
+ * never returns into the compiled code: it pops fn and arg from its new stack, and exits inside the asm.
+ *
+ * @param fn the function that the thread runs
+ * @param arg the argument of the function
+ * @param stackTop the top of the stack of the new thread (aligned to 16 bytes)
+ * @param tid the pointer to store the thread id
+ * @return On success, the thread id is returned. On error, -errno will be returned.
+ */
+static inline long spawnThread(int (*fn)(void *), void *arg, char *stackTop, int *tid) {
+    long ret;
+    long *stack = (long *) stackTop;
+
+    *--stack = (long) arg; //the child thread pops fn and arg from its new stack
+    *--stack = (long) fn;
+
+    register long childTid asm("r10") = (long) tid;
+    register long tls asm("r8") = 0; //share the thread local storage
+
+    asm volatile("syscall\n\t"
+        "testq %%rax, %%rax\n\t"
+        "jnz 1f\n\t"                  //the parent jumps to 1
+        "xorq %%rbp, %%rbp\n\t"       //the child thread starts here, on the new stack
+        "popq %%rax\n\t"              //fn
+        "popq %%rdi\n\t"              //arg
+        "callq *%%rax\n\t"
+        "movq %%rax, %%rdi\n\t"
+        "movq %7, %%rax\n\t"          //%7 == (long) EXIT_SYSCALL, which terminates only this thread
+        "syscall\n\t"
+        "1:"
+        : "=a"(ret)
+        : "a"((long) CLONE_SYSCALL), "D"((long) THREAD_CLONE_FLAGS), "S"(stack), "d"(tid), "r"(childTid), "r"(tls),
+          "i"(EXIT_SYSCALL)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function waits until the thread that was created by the spawnThread() exits.
+ *
+ * @param tid the pointer that stores the thread id, which is cleared by the kernel when the thread exits
+ */
+static inline void joinThread(int *tid) {
+    int value;
+
+    while ((value = __atomic_load_n(tid, __ATOMIC_ACQUIRE)) != 0) {
+        futexCall(tid, FUTEX_WAIT, value, NULL); //the kernel wakes the shared futex on the tid
+    }
+}
+
+/**
+ * This function initialises the given arena. No memory is mapped until the first allocation.
+ *
+ * @param a the arena
+ */
+static inline void initArena(struct arena *a) {
+    a->chunk = NULL;
+    a->brkp = NULL;
+    a->endp = NULL;
+    a->spare = NULL;
+    a->used = 0;
+    a->peak = 0;
+    a->mapped = 0;
+    a->peakMapped = 0;
+}
+
+/**
+ * This function chains a new chunk to the given arena, which has at least the given number of free bytes.
+ * The chunks double in size (up to ARENA_MAX_CHUNK), so the number of the mmap syscalls stays small.
+ * The spare chunk that was released by the resetArena() is reused if it is big enough.
+ *
+ * @param a the arena
+ * @param size the number of bytes that should fit in the new chunk
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+static inline int growArena(struct arena *a, long size) {
+    long need = size + ARENA_HEADER_SIZE;
+    struct arenaChunk *chunk = a->spare;
+
+    if (chunk != NULL && chunk->size >= need) {
+        a->spare = NULL;
+    } else {
+        long chunkSize = (a->chunk != NULL) ? a->chunk->size * 2 : ARENA_CHUNK_SIZE;
+
+        if (chunkSize > ARENA_MAX_CHUNK) {
+            chunkSize = ARENA_MAX_CHUNK;
+        }
+        if (chunkSize < need) { //a huge allocation gets its own chunk
+            chunkSize = (need + ARENA_PAGE_SIZE - 1) & ~(long) (ARENA_PAGE_SIZE - 1);
+        }
+
+        long addr = mapMemory(chunkSize);
+
+        if (addr < 0) {
+            return -1;
+        }
+
+        chunk = (struct arenaChunk *) addr;
+        chunk->size = chunkSize;
+        a->mapped += chunkSize;
+        if (a->mapped > a->peakMapped) {
+            a->peakMapped = a->mapped;
+        }
+    }
+
+    chunk->prev = a->chunk;
+    a->chunk = chunk;
+    a->brkp = (char *) chunk + ARENA_HEADER_SIZE;
+    a->endp = (char *) chunk + chunk->size;
+    return 0;
+}
+
+/**
+ * This function allocates the given number of bytes from the given arena by moving its break.
+ * When the current chunk is full, a new chunk is chained to the arena, so the allocation only fails
+ * when the mmap syscall fails.
+ *
+ * @param a the arena
+ * @param size the number of bytes to allocate
+ * @return the allocated memory (aligned to ARENA_ALIGN bytes), or NULL if the mmap syscall failed
+ */
+static inline void *allocateFromArena(struct arena *a, long size) {
+    size = (size + ARENA_ALIGN - 1) & ~(long) (ARENA_ALIGN - 1);
+
+    if (a->endp - a->brkp < size && growArena(a, size) < 0) {
+        return NULL;
+    }
+
+    void *memp = (void *) a->brkp;
+    a->brkp += size;
+    a->used += size;
+    if (a->used > a->peak) {
+        a->peak = a->used;
+    }
+
+    return memp;
+}
+
+/**
+ * This function records the current break of the given arena, so that every allocation after this mark
+ * could be released in bulk with the resetArena().
+ *
+ * @param a the arena
+ * @return the mark
+ */
+static inline struct arenaMark markArena(struct arena *a) {
+    struct arenaMark mark = { a->chunk, a->brkp, a->used };
+    return mark;
+}
+
+/**
+ * This function releases every allocation after the given mark.
+ * The chunks that were chained after the mark are unmapped, except the biggest one, which is kept
+ * as the spare chunk, so that a loop of mark and reset does not call the mmap syscall every time.
+ *
+ * @param a the arena
+ * @param mark the mark that was returned by the markArena()
+ */
+static inline void resetArena(struct arena *a, struct arenaMark mark) {
+    while (a->chunk != mark.chunk) {
+        struct arenaChunk *chunk = a->chunk;
+        a->chunk = chunk->prev;
+
+        if (a->spare != NULL && a->spare->size >= chunk->size) {
+            a->mapped -= chunk->size;
+            unmapMemory((char *) chunk, chunk->size);
+        } else {
+            if (a->spare != NULL) {
+                a->mapped -= a->spare->size;
+                unmapMemory((char *) a->spare, a->spare->size);
+            }
+            a->spare = chunk;
+        }
+    }
+
+    a->brkp = mark.brkp;
+    a->endp = (mark.chunk != NULL) ? (char *) mark.chunk + mark.chunk->size : NULL;
+    a->used = mark.used;
+}
+
+/**
+ * This function unmaps every chunk of the given arena.
+ *
+ * @param a the arena
+ */
+static inline void releaseArena(struct arena *a) {
+    struct arenaMark empty = { NULL, NULL, 0 };
+
+    resetArena(a, empty);
+
+    if (a->spare != NULL) {
+        a->mapped -= a->spare->size;
+        unmapMemory((char *) a->spare, a->spare->size);
+        a->spare = NULL;
+    }
+}
+
+/**
+ * This function initialises the custom heap, which is the arena of the tool.
+ */
+static inline void initHeap() {
+    initArena(&heap);
+}
+
+/**
+ * This function unmaps every chunk of the custom heap.
+ */
+static inline void myUnMap() {
+    releaseArena(&heap);
+}
+
+/**
+ * The aim of this function is to allocate the memory dynamically from the custom heap.
+ * The worker threads share the heap, so the break is moved with the heap locked
+ * (a new chunk could be chained to the heap in the meantime).
+ *
+ * To implement this custom sbrk function, I copied some of the codes from the following article.
+ * @reference <https://people.kth.se/~johanmon/ose/assignments/maplloc.pdf>
+ *
+ * @param size the number of bytes to allocate
+ * @return the allocated memory, or NULL if the mmap syscall failed
+ */
+static inline void *mysbrk(size_t size) {
+    spinLock(&heapLock);
+    void *memp = allocateFromArena(&heap, size);
+    spinUnlock(&heapLock);
+
+    return memp;
+}
+
+/**
+ * This function prints out the usage of the given arena via stderr stream (the -T option).
+ *
+ * @param name the name of the arena
+ * @param a the arena
+ */
+static inline void printArenaStats(const char *name, struct arena *a) {
+    char num[21];
+
+    printErr(name);
+    printErr(": current ");
+    printErr(formatNumber(a->used, num));
+    printErr(" bytes, peak ");
+    printErr(formatNumber(a->peak, num));
+    printErr(" bytes, mapped ");
+    printErr(formatNumber(a->mapped, num));
+    printErr(" bytes (peak ");
+    printErr(formatNumber(a->peakMapped, num));
+    printErr(" bytes)\n");
+}
+
+#endif
@@ -3,39 +3,37 @@
 #include <fcntl.h>
 #include <stdarg.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <time.h>
+#include <errno.h>
+#include "common.h"
 
-/* system call numbers */
-#define READ_SYSCALL 0  //to read the file to copy the data of that file
-#define WRITE_SYSCALL 1 //to copy the data from the original file
+/* system call numbers (the read, write, close, fstat, mmap and munmap syscalls are wrapped in syscall.h) */
 #define OPEN_SYSCALL 2  //to open the directory or file
-#define CLOSE_SYSCALL 3 //to close the opened directory or file
 #define STAT_SYSCALL 4  //to get the file stat of the specific file
+#define SENDFILE_SYSCALL 40 //to copy the data between file descriptors inside the kernel
+#define SPLICE_SYSCALL 275  //to move the data from (or to) a pipe without copying it to the user space
 
 /* preprocessor for the file permission mode */
 #define OPEN_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) //the mode for the open syscall
 
-/* preprocessor for the buffer size */
-#define BUF_SIZE 1024
-#define READ_SIZE 1023
+/* preprocessors for the zero-copy engine */
+#define ZERO_COPY_CHUNK 0x40000000 //the maximum number of bytes to move with a single sendfile or splice syscall (1 GiB)
+#define SPLICE_F_MOVE 1            //hint the kernel to move the pages instead of copying them
+#define SPLICE_F_MORE 4            //hint the kernel that more data will be coming in a subsequent splice
 
+/* types of the file descriptors, which are used for choosing the data path */
+#define FD_TYPE_OTHER 0   //tty, character device, etc
+#define FD_TYPE_REGULAR 1 //regular file
+#define FD_TYPE_PIPE 2    //pipe or fifo
+#define FD_TYPE_SOCKET 3  //socket
 
-/**
- * The custom strlen function.
- *
- * @param str the string to check it's length
- * @return the length of the string
- */
-int strlength(const char *str) {
-    int count = 0;
+/* data paths of the mycat */
+#define PATH_READ_WRITE 0 //copy the data via the user space buffer
+#define PATH_SENDFILE 1   //copy the data with the sendfile syscall
+#define PATH_SPLICE 2     //move the data with the splice syscall
 
-    while (*str != '\0') { //iterate the while loop until it reaches to the terminator character
-        count += 1;
-        str += 1;
-    }
-
-    return count;
-}
+struct ioBuffer catBuffer = { NULL, 0, 0 }; //the buffer of the read/write loop, which is reused across the files
 
 /**
  * The aim of this funciton is to check the digits of the given number.
@@ -52,121 +50,177 @@ int checkDigits(int num) {
 }
 
 /**
- * This function is a wrapper function of the write syscall.
- * This function uses the inline assembly function to make interaction with the kernel more explicit.
- * To implement this function, I reused the given code, which is written by Kasim Terzic.
+ * This function is a wrapper function of open system call.
  *
- * @param text the target text that should be printed out
- * @param handle for stdout, 2 for stderr, file handle from open() for files
- * @return ret If the syscall success, returns 1. Otherwise, returns -1.
+ * @param name the name of the directory that should be opened
+ * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. Otherwise, returns some negative value.
  */
-int writeText(const char *text, long handle) {
-    size_t len = strlength(text); //Length of our string, which we need to pass to write syscall
-    long ret = -1;                //Return value received from the system call
-
-    asm("movq %1, %%rax\n\t" // %1 == (long) WRITE_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == handle
-        "movq %3, %%rsi\n\t" // %3 == text
-        "movq %4, %%rdx\n\t" // %4 == len
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ret
-        : "=r"(ret)          /* if the syscall success, 1 will be stored in the ret. */
-        : "r"((long)WRITE_SYSCALL), "r"(handle), "r"(text), "r"(len)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory"
-    );
-
-    return ret;
+int openFile(char *name) {
+    return syscall3(OPEN_SYSCALL, (long) name, O_RDONLY, OPEN_MODE);
 }
 
 /**
- * This function is a wrapper function of open system call.
+ * This function uses the stat syscall to check if the file with the given name is a directory or a file.
  *
- * @param name the name of the directory that should be opened
- * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. Otherwise, returns some negative value.
+ * @param name the name of the file (or directory)
+ * @param statBuffer the buffer to store the file stat
+ * @return If the stat syscall fails, returns -1. If the given file is a directory, returns 1. Otherwise, returns 0.
  */
-int openFile(char *name) {
-    long ret = -1;
-    int flag = O_RDONLY;
-    int mode = OPEN_MODE;
-
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = name
-        "movq %3, %%rsi\n\t" // %3 = flag
-        "movq %4, %%rdx\n\t" // %4 = mode
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)OPEN_SYSCALL), "r"(name), "r"((long)flag), "r"((long)mode)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-    return ret;
+int checkFileStat(char *name, struct stat *statBuffer) {
+    return syscall2(STAT_SYSCALL, (long) name, (long) statBuffer);
 }
 
 /**
- * This is a wrapper function of the close syscall.
+ * This function is a wrapper function of the sendfile system call.
+ * It copies the data from inFd to outFd inside the kernel, starting at the current file offset of the inFd.
  *
- * @param fd the file descriptor of the opened file (or directory)
- * @return Returns zero on success. On error, negative value would be returned, which will depend on the setted error number.
+ * @param outFd the file descriptor to write the data
+ * @param inFd the file descriptor to read the data
+ * @param count the maximum number of bytes to copy
+ * @return Returns the number of bytes that were copied. On error, -errno will be returned.
  */
-int closeFile(long fd) {
-    long ret = -1;
-
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fd
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)CLOSE_SYSCALL), "r"(fd)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-    return ret;
+long sendFile(long outFd, long inFd, long count) {
+    return syscall4(SENDFILE_SYSCALL, outFd, inFd, 0, count); //NULL offset, to use the file offset of the inFd
 }
 
 /**
- * This function is a wrapper function of the read system call.
- * It reads the data from the file that is corresponding to the given file descriptor.
+ * This function is a wrapper function of the splice system call.
+ * Either inFd or outFd should be a pipe. Both file offsets are used and updated by the kernel.
+ *
+ * @param inFd the file descriptor to read the data
+ * @param outFd the file descriptor to write the data
+ * @param count the maximum number of bytes to move
+ * @return Returns the number of bytes that were moved. On error, -errno will be returned.
+ */
+long spliceFile(long inFd, long outFd, long count) {
+    //NULL offsets, to use the file offsets of both file descriptors
+    return syscall6(SPLICE_SYSCALL, inFd, 0, outFd, 0, count, SPLICE_F_MOVE | SPLICE_F_MORE);
+}
+
+/**
+ * This function checks the type of the file that is corresponding to the given file stat.
+ *
+ * @param stats the file stat of the opened file descriptor
+ * @return One of FD_TYPE_REGULAR, FD_TYPE_PIPE, FD_TYPE_SOCKET and FD_TYPE_OTHER.
+ */
+int checkFdType(struct stat *stats) {
+    if (S_ISREG(stats->st_mode)) {
+        return FD_TYPE_REGULAR;
+    } else if (S_ISFIFO(stats->st_mode)) {
+        return FD_TYPE_PIPE;
+    } else if (S_ISSOCK(stats->st_mode)) {
+        return FD_TYPE_SOCKET;
+    }
+    return FD_TYPE_OTHER;
+}
+
+/**
+ * This function probes the type of the file descriptor with the fstat syscall.
  *
  * @param fd the file descriptor
- * @param buf the buffer to store the read data
- * @param count the total number of bits to read
- * @return Returns the number of bytes that were read. If value is negative, then the system call returned an error.
+ * @return One of FD_TYPE_REGULAR, FD_TYPE_PIPE, FD_TYPE_SOCKET and FD_TYPE_OTHER.
  */
-int readFile(unsigned int fd, char *buf, long count) {
-    long ret = -1;
-
-    asm("movq %1, %%rax\n\t" // %1 = (long) READ_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = (long) fd
-        "movq %3, %%rsi\n\t" // %3 = buf
-        "movq %4, %%rdx\n\t" // %4 = count
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)READ_SYSCALL), "r"((long)fd), "r"(buf), "r"(count) //convert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-    return ret;
+int probeFdType(long fd) {
+    struct stat stats;
+
+    if (checkFdStat(fd, &stats) != 0) {
+        return FD_TYPE_OTHER;
+    }
+    return checkFdType(&stats);
 }
 
 /**
- * This function uses the stat syscall to check if the file with the given name is a directory or a file.
+ * This function chooses the data path for copying the data from the inFd to the outFd.
+ * The splice syscall requires a pipe on either side, and the sendfile syscall needs an input that
+ * could be mapped into the page cache, so every other combination falls back to the read/write loop.
  *
- * @param name the name of the file (or directory)
- * @param statBuffer the buffer to store the file stat
- * @return If the stat syscall fails, returns -1. If the given file is a directory, returns 1. Otherwise, returns 0.
+ * @param inType the type of the input file descriptor
+ * @param outType the type of the output file descriptor
+ * @return One of PATH_SPLICE, PATH_SENDFILE and PATH_READ_WRITE.
  */
-int checkFileStat(char *name, struct stat *statBuffer) {
-    long ret = -1;
-
-    asm("movq %1, %%rax\n\t" // %1 = (long) STAT_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fileName
-        "movq %3, %%rsi\n\t" // %3 = statBuffer
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) STAT_SYSCALL), "r"(name), "r"(statBuffer) //covert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "memory");
-
-    return ret;
+int chooseDataPath(int inType, int outType) {
+    if (inType == FD_TYPE_PIPE || outType == FD_TYPE_PIPE) {
+        return PATH_SPLICE;
+    }
+
+    if (inType == FD_TYPE_REGULAR && (outType == FD_TYPE_REGULAR || outType == FD_TYPE_SOCKET)) {
+        return PATH_SENDFILE;
+    }
+
+    return PATH_READ_WRITE;
+}
+
+/**
+ * This function copies the data from the given file descriptor to stdout via the user space buffer.
+ * The number of bytes returned by the read syscall is passed to the write syscall as it is,
+ * so that the files that contain the zero bytes are copied without being truncated.
+ *
+ * @param fd the file descriptor to read the data
+ * @param fileSize the size of the file, which is used for choosing the size of the buffer
+ */
+void catViaReadWrite(long fd, long fileSize) {
+    if (reserveBuffer(&catBuffer, chooseBufferSize(fileSize)) < 0) {
+        writeText("mycat: failed to allocate the buffer\n", 2);
+        return;
+    }
+
+    long length;
+
+    for (;;) {
+        length = readFile(fd, catBuffer.data, catBuffer.size);
+
+        if (length == -EINTR) {
+            continue;
+        } else if (length <= 0) {
+            break;
+        }
+
+        if (writeBytes(1, catBuffer.data, length) < 0) {
+            break;
+        }
+    }
+}
+
+/**
+ * This function copies the data from the given file descriptor to stdout without copying it to the user space.
+ * If the kernel refuses the zero-copy path for this pair of file descriptors (i.e. stdout is opened with O_APPEND),
+ * the rest of the data will be copied with the read/write loop. Since both sendfile and splice advance
+ * the file offsets, the fallback continues exactly where the zero-copy path stopped.
+ *
+ * @param fd the file descriptor to read the data
+ * @param stats the file stat of the input file descriptor
+ */
+void catFd(long fd, struct stat *stats) {
+    static int outType = -1; //stdout never changes, so it is probed only once
+
+    if (outType < 0) {
+        outType = probeFdType(1);
+    }
+
+    int path = chooseDataPath(checkFdType(stats), outType);
+    long ret = 0;
+
+    while (path != PATH_READ_WRITE) {
+        if (path == PATH_SPLICE) {
+            ret = spliceFile(fd, 1, ZERO_COPY_CHUNK);
+        } else {
+            ret = sendFile(1, fd, ZERO_COPY_CHUNK);
+        }
+
+        if (ret > 0) {
+            continue;
+        } else if (ret == 0) { //end of file
+            return;
+        } else if (ret == -EINTR) {
+            continue;
+        } else if (ret == -EINVAL || ret == -ENOSYS || ret == -EOPNOTSUPP) {
+            path = PATH_READ_WRITE; //this pair of file descriptors could not take part in the zero-copy path
+        } else {
+            return;
+        }
+    }
+
+    catViaReadWrite(fd, S_ISREG(stats->st_mode) ? stats->st_size : 0);
 }
 
 /**
@@ -203,13 +257,7 @@ void mycat(char *name) {
         return;
     }
 
-    char buffer[BUF_SIZE];
-    int length;
-    //Reads max 1023 byte at once.
-    while ((length = readFile(fd, buffer, READ_SIZE)) > 0) {
-        buffer[length] = '\0';
-        writeText(buffer, 1);
-    }
+    catFd(fd, &stats);
 
     closeFile(fd);
 }
@@ -219,14 +267,12 @@ void mycat(char *name) {
  * This function will read the string via stdin stream, and print out the read string via stdout stream.
  */
 void readAndCatViaStdin() {
-    char buffer[BUF_SIZE]; //initialize the buffer
+    struct stat stats;
 
-    int length;
-    //Reads max 1023 byte at once.
-    while ((length = readFile(0, buffer, READ_SIZE)) > 0) {
-        buffer[length] = '\0';
-        writeText(buffer, 1);
+    if (checkFdStat(0, &stats) != 0) {
+        stats.st_mode = 0; //unknown type, use the read/write loop
     }
+    catFd(0, &stats);
     return;
 }
 
@@ -2,747 +2,3200 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <fcntl.h>
 #include <time.h>
 #include <dirent.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <linux/fs.h>
+#include "common.h"
 
-/* system call numbers */
-#define READ_SYSCALL 0      //to read the file to copy the data of that file
-#define WRITE_SYSCALL 1     //to copy the data from the original file
-#define OPEN_SYSCALL 2      //to open the directory or file
-#define CLOSE_SYSCALL 3     //to close the opened directory or file
+/* system call numbers (the read, write, close, fstat, mmap, munmap, access and exit_group syscalls are wrapped in syscall.h,
+   and the sched_yield, clone, exit and futex syscalls in common.h) */
 #define STAT_SYSCALL 4      //to get the file stat of the specific file
-#define MMAP_SYSCALL 9      //to implement the custom malloc
-#define MUNMAP_SYSCALL 11   //to unmap the dynamically mapped memory
-#define ACCESS_SYSCALL 21   //to check if the file exists
-#define EXIT_SYSCALL 60     //to terminate the process when the error occurred
-#define TRUNC_SYSCALL 76    //to truncate the file that is specified by the file path
+#define LSEEK_SYSCALL 8     //to find the data extents and the holes of the sparse files
+#define IOCTL_SYSCALL 16    //to clone the file with the FICLONE ioctl
+#define PREAD64_SYSCALL 17  //to read the blocks of the existing destination file (the block delta)
+#define PWRITE64_SYSCALL 18 //to rewrite only the changed blocks of the destination file
 #define FTRUNC_SYSCALL 77   //to truncate the file that is specified by the file descriptor
-#define GETDENTS_SYSCALL 78 //to get the directory entries
 #define MKDIR_SYSCALL 83    //to make the directory
 #define RMDIR_SYSCALL 84    //to remove the directory
-#define CREAT_SYSCALL 85    //to create the file
-#define UNLINK_SYSCALL 87   //to remove the file from the file system
-#define CHMOD_SYSCALL 90    //to change the mode(file permission) of the file
-#define CHOWN_SYSCALL 92    //to change the user id and group id of the file.
+#define FCHMOD_SYSCALL 91   //to change the mode(file permission) of the opened file
+#define FCHOWN_SYSCALL 93   //to change the user id and group id of the opened file
+#define GETDENTS64_SYSCALL 217 //to get the directory entries
+#define OPENAT_SYSCALL 257  //to open the file (or directory) relative to the opened directory
+#define MKDIRAT_SYSCALL 258 //to make the directory relative to the opened directory
+#define NEWFSTATAT_SYSCALL 262 //to get the file stat of the file relative to the opened directory
+#define UNLINKAT_SYSCALL 263 //to remove the file relative to the opened directory
+#define LINKAT_SYSCALL 265  //to recreate the later hardlinks of the copied file (the -H option)
+#define UTIMENSAT_SYSCALL 280 //to copy the modified time of the source file to the destination file (the incremental mode)
+#define PRLIMIT64_SYSCALL 302 //to raise the limit of the open file descriptors, since every level of the walk keeps its directories open
+#define COPY_FILE_RANGE_SYSCALL 326 //to copy the data between the files inside the kernel
+#define IO_URING_SETUP_SYSCALL 425 //to set up the io_uring instance for the asynchronous copy
+#define IO_URING_ENTER_SYSCALL 426 //to submit the SQEs and wait for the completions
 
 /* preprocessors for the file permission mode */
-#define OPEN_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH)              //the mode for the open syscall
 #define MKDIR_MODE (S_IRWXU | S_IRWXG | S_IROTH)                       //the mode for the mkdir syscall
-#define CREATE_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH | S_IWOTH ) //the mode for the creat syscall
+#define CREATE_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH | S_IWOTH ) //the mode for the new files
+
+/* preprocessors for the openat syscall */
+#define CREATE_FLAG (O_WRONLY | O_CREAT | O_TRUNC) //the flags to create the new file (same as the creat syscall)
+#define DIR_FLAG (O_RDONLY | O_DIRECTORY)          //the flags to open the directory of the walk
 
 /* preprocessors for the buffer size */
-#define READ_SIZE 4096     //buffer size for the read syscall
-#define GETDENTS_SIZE 2048 //buffer size for the getdents syscall
+#define MIN_DIRENT_BUFFER 8192  //the smallest buffer for the getdents64 syscall
+#define MAX_DIRENT_BUFFER 1048576 //1 MiB, the largest buffer for the getdents64 syscall
+#define NAME_SIZE 256           //the maximum length of the file name (NAME_MAX) with the terminator
+#define MAX_DIRENT_RECORD 280   //the biggest linux_dirent64 (the name and the 19-byte header, aligned to 8 bytes)
+#define RADIX_BUCKETS 256       //the radix sort of the inode order sorts the 64-bit keys one byte at a time
+#define MIN_WALK_DEPTH 16       //the initial number of levels of the stack of the directory walk
+
+/* preprocessors for the io_uring copy engine */
+#define DEFAULT_QUEUE_DEPTH 32    //the default number of SQEs that are kept in flight
+#define MAX_QUEUE_DEPTH 4096      //the maximum queue depth that could be given with the -q option
+#define URING_BLOCK_SIZE 131072   //128 KiB, the size of each block that is read and written by a single SQE
+#define URING_MAX_PENDING 1024    //the maximum number of queued files before the directory walk waits for the engine
+#define RING_PROT (PROT_READ | PROT_WRITE)
+#define RING_FLAG (MAP_SHARED | MAP_POPULATE)
+
+/* copy modes, which are selected with the -m option */
+#define MODE_RW 0    //the blocking read/write loop
+#define MODE_URING 1 //the asynchronous io_uring copy engine
+#define MODE_AUTO 2  //FICLONE, then copy_file_range, then the read/write loop
+#define MODE_CLONE 3 //FICLONE, then the read/write loop
+#define MODE_RANGE 4 //copy_file_range, then the read/write loop
+
+/* preprocessors for the parallel copy */
+#define MAX_WORKERS 256             //the maximum number of workers that could be given with the -j option
+#define WORKER_STACK_SIZE 262144    //256 KiB, the stack of each worker thread
+#define IDLE_WAIT_NS 10000000       //10 ms, the maximum time that an idle worker sleeps before checking the deques again
+#define TASK_FILE 0                 //the task copies a file
+#define TASK_DIR 1                  //the task scans a directory
+#define MAX_QUEUED_TASKS 4096       //the scanner copies the files by itself while this many tasks are queued
+
+/* results of the copy tiers */
+#define TIER_DONE 0     //the tier copied the whole file
+#define TIER_FALLBACK 1 //the tier is not supported for this pair of files, so the next tier should be tried
+
+#define COPY_RANGE_CHUNK 0x8000000 //128 MiB, the number of bytes to copy with a single copy_file_range syscall
+#define COPY_UNTIL_EOF 0x7fffffffffffffffL //the number of bytes to copy when the whole file should be copied
+#define ZERO_BLOCK_SIZE 4096       //the size of the block that is checked by the zero-block detection
+
+/* states of the destination file in the incremental mode */
+#define DEST_MISSING 0   //the destination file does not exist (or is not a regular file), so it is copied as a new file
+#define DEST_CHANGED 1   //the destination file has a different size or modified time, so it is copied again
+#define DEST_UNCHANGED 2 //the destination file has the same size and modified time, so it is skipped
+#define DELTA_BLOCK_SIZE 4096 //the size of the block that is compared with the destination file by the block delta
+
+/* The verify mode (the -V option), the manifest of the checksums (the -M and -c options), and the CRC-32C */
+#define VERIFY_NONE 0   //the copied files are not read again
+#define VERIFY_CACHE 1  //the destination file is read again through the page cache
+#define VERIFY_DIRECT 2 //the destination file is read again with the O_DIRECT, from the storage
+#define DIRECT_FLAG (O_RDONLY | __O_DIRECT) //the fcntl.h defines the O_DIRECT only with the _GNU_SOURCE
+#define MANIFEST_FLAG (O_WRONLY | O_CREAT | O_TRUNC | O_APPEND) //each line is appended with a single write, so the lines of the workers never interleave
+#define MANIFEST_LINE_SIZE 4112 //the checksum, 2 spaces, the path (PATH_MAX) and the newline
+#define CRC32C_POLY 0x82f63b78U //the reflected polynomial of the CRC-32C (Castagnoli)
+#define CPUID_SSE42 (1U << 20)  //the bit of the SSE4.2 (the crc32 instruction) in the ecx of the cpuid leaf 1
+
+/* The hardlink table (the -H option) */
+#define MIN_LINK_SLOTS 4096 //the initial number of the slots of the hardlink table (a power of 2)
+#define PATH_SIZE 4096      //the size of the buffer for the path of the first copy (PATH_MAX)
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15UL //the multiplier of the Fibonacci hashing (2^64 divided by the golden ratio)
+
+/* states of the slots of the io_uring copy engine */
+#define SLOT_FREE 0    //the slot is not used
+#define SLOT_READING 1 //the read SQE of the slot is in flight
+#define SLOT_WRITING 2 //the write SQE of the slot is in flight
 
 /* 
- * The struct for the getdents syscall 
+ * The struct for the getdents64 syscall 
  * I found this struct from the linux man page.
+ * Unlike the legacy linux_dirent, the d_type is a field before the d_name.
  *
  * @reference http://man7.org/linux/man-pages/man2/getdents.2.html
  */
-struct linux_dirent {
-    long d_ino;              /* The inode number */
-    off_t d_off;             /* Offset to next linux_dirent */
-    unsigned short d_reclen; /* Length of this linux_dirent */
+struct linux_dirent64 {
+    unsigned long d_ino;     /* 64-bit inode number */
+    long d_off;              /* 64-bit offset to next structure */
+    unsigned short d_reclen; /* Size of this dirent */
+    unsigned char d_type;    /* File type */
     char d_name[];           /* Filename (null-terminated) */
 };
 
+struct ioBuffer copyBuffer = { NULL, 0, 0 };
+
+/*
+ * struct for the directory that is opened by the directory walk.
+ * The files and the sub-directories in it are opened relative to its file descriptors, so the walk
+ * never builds the path names. The directory is shared by the levels of the walk, the queued files
+ * and the sub-directories, and its file descriptors are closed when the last of them releases it.
+ */
+struct dirNode {
+    struct dirNode *parent;     //the parent directory, or NULL for the source directory
+    char *name;                 //the name in the parent directory (the path name for the source directory)
+    char *destName;             //the path name of the destination directory (only for the source directory)
+    int srcFd;                  //the file descriptor of the source directory
+    int dstFd;                  //the file descriptor of the destination directory
+    int refs;                   //the number of users of this directory
+    char nameBuf[NAME_SIZE];    //the copy of the name, since the getdents buffer is reused
+    struct dirNode *nextFree;   //pointer that points to the next released directory
+};
+
+/*
+ * struct for the entries of a whole directory in the order of their inode numbers (the -I option).
+ * The linux_dirent64 records stay in the getdents64 buffer, and only their offsets are sorted.
+ * The arrays only grow, so they are reused by the following directories.
+ */
+struct inodeOrder {
+    unsigned int *offsets;     //the offsets of the records in the getdents64 buffer, sorted by the inode numbers
+    unsigned int *tempOffsets; //the temporary array of the radix sort
+    unsigned long *keys;       //the inode numbers of the records
+    unsigned long *tempKeys;   //the temporary array of the radix sort
+    long capacity;             //the number of records that the arrays can store
+    long count;                //the number of records of the current directory
+    long next;                 //the index of the next record
+};
+
+/* struct for a level of the stack of the directory walk */
+struct walkLevel {
+    struct dirNode *dir; //the directory that is read at this level
+    char *buf;           //the buffer for the getdents64 syscall, which is reused by the directories at this depth
+    long bufSize;        //the size of the buffer
+    long nread;          //the number of bytes in the buffer
+    long bpos;           //the offset of the next entry in the buffer
+    struct inodeOrder byInode; //the order of the entries with the -I option
+};
+
+struct dirNode *freeNodes = NULL; //the released directories, which are reused by the walk
+int freeNodeLock = 0;             //the spin lock of the freeNodes
+
+/* struct for the mapped rings of the io_uring instance */
+struct uringRing {
+    int fd;                     //the file descriptor of the io_uring instance
+    unsigned *sqHead;           //the head of the submission queue (updated by the kernel)
+    unsigned *sqTail;           //the tail of the submission queue (updated by the mycp)
+    unsigned *sqMask;           //the mask for the index of the submission queue
+    unsigned *sqArray;          //the array of the indexes of the SQEs
+    unsigned *cqHead;           //the head of the completion queue (updated by the mycp)
+    unsigned *cqTail;           //the tail of the completion queue (updated by the kernel)
+    unsigned *cqMask;           //the mask for the index of the completion queue
+    struct io_uring_sqe *sqes;  //the array of the SQEs
+    struct io_uring_cqe *cqes;  //the array of the CQEs
+    char *sqRing;               //the mapped submission queue ring
+    char *cqRing;               //the mapped completion queue ring (same as sqRing with IORING_FEAT_SINGLE_MMAP)
+    long sqRingSize;            //the size of the mapped submission queue ring
+    long cqRingSize;            //the size of the mapped completion queue ring
+    long sqesSize;              //the size of the mapped SQE array
+    unsigned toSubmit;          //the number of SQEs that are queued but not submitted yet
+};
+
+/* struct for the file that is copied by the io_uring copy engine */
+struct uringJob {
+    struct dirNode *dir;    //the directory that contains the file
+    char *name;             //the name of the file in that directory
+    char nameBuf[NAME_SIZE]; //the copy of the name, since the getdents buffer is reused
+    int readFd;             //the file descriptor of the source file
+    int fd;                 //the file descriptor of the destination file
+    long size;              //the size of the source file
+    long nextOffset;        //the offset of the next block that should be read
+    int pending;            //the number of slots that are working on this file
+    char eof;               //set when the source file turned out to be shorter than its stat
+    char failed;            //set when any read or write of this file failed
+    struct stat stats;      //the file stat of the source file
+    struct uringJob *next;  //pointer that points to the next file in the queue
+};
+
+/* struct for the block buffer, which cycles between reading a block and writing it */
+struct uringSlot {
+    struct uringJob *job; //the file that this slot is working on
+    char *data;           //the block buffer of this slot
+    long offset;          //the offset of the block in the file
+    long length;          //the number of bytes that should be read into this block
+    long got;             //the number of bytes that were read
+    long written;         //the number of bytes that were written
+    char state;           //one of SLOT_FREE, SLOT_READING and SLOT_WRITING
+};
+
+/* The global variables for the io_uring copy engine */
+struct uringRing ring;
+struct uringSlot *slots = NULL;    //the array of the block buffers (queue depth slots)
+struct uringJob **activeJobs;      //the files that are opened and being copied
+struct uringJob *pendingHead = NULL; //the queue of the files that are waiting to be opened
+struct uringJob *pendingTail = NULL;
+struct uringJob *freeJobs = NULL;  //the finished files, which are reused by the next files
+int pendingCount = 0;              //the number of files in the pending queue
+int activeCount = 0;               //the number of files in the activeJobs
+int maxActiveJobs = 1;             //the maximum number of files in flight
+int roundRobin = 0;                //the index of the active file that gets the next free slot
+
+/* struct for the slot of the hardlink table, which maps the inode of a source file to the path of its first copy */
+struct linkSlot {
+    unsigned long ino; //the inode number of the source file
+    unsigned long dev; //the device of the source file
+    char *path;        //the path of the first copy in the destination (NULL for the empty slot)
+};
+
+/* The global variables for the hardlink table (the -H option), which is shared by the workers of the parallel copy */
+struct linkSlot *linkSlots = NULL; //the open addressing hash table (with the linear probing) in the arena
+long linkMask = 0;                 //the number of the slots - 1
+long linkCount = 0;                //the number of the inodes in the table
+int linkLock = 0;                  //the spin lock of the hardlink table
+long linkedFiles = 0;              //the number of the files that were recreated with the linkat syscall
+struct arena linkArena;            //the slots and the paths of the table, which are kept out of the heap (the parallel copy resets the heap)
+
+/* The global variables for the command line options */
+int copyMode = MODE_AUTO;            //the copy mode that is selected with the -m option
+int queueDepth = DEFAULT_QUEUE_DEPTH; //the queue depth that is selected with the -q option
+char sparseMode = 0;                 //set by the -s option, copies only the data extents of the source file
+char zeroDetect = 0;                 //set by the -z option, turns the zero blocks into holes as well
+char inodeOrder = 0;                 //set by the -I option, opens the entries of each directory in the order of their inode numbers
+char incremental = 0;                //set by the -i option, skips the files whose destination has the same size and modified time
+char deltaMode = 0;                  //set by the -d option, rewrites only the changed blocks of the existing destination files (implies -i)
+int verifyMode = VERIFY_NONE;        //set by the -V option, reads each copied file again and compares the checksums
+char *manifestName = NULL;           //set by the -M option, the file to write the checksums of the copied files
+char *checkName = NULL;              //set by the -c option, the manifest to check instead of copying
+char checksumMode = 0;               //set when the copied data is checksummed (the -V and -M options)
+char hardlinkMode = 0;               //set by the -H option, recreates the hardlinks of the source files in the destination
+
+/* struct for the task of the parallel copy */
+struct copyTask {
+    char type;              //TASK_FILE or TASK_DIR
+    struct dirNode *dir;    //the directory that contains the file (or the directory to scan)
+    char *name;             //the name of the file in that directory (NULL for the directory task)
+    char nameBuf[NAME_SIZE]; //the copy of the name, since the getdents buffer is reused
+    struct copyTask *prev;  //pointer that points to the older task in the deque
+    struct copyTask *next;  //pointer that points to the newer task in the deque
+};
+
+/* struct for the worker of the parallel copy, which owns a deque of the tasks */
+struct worker {
+    int index;               //the index of this worker
+    int tid;                 //the thread id, which is cleared by the kernel when the thread exits
+    int lock;                //the spin lock of the deque
+    int count;               //the number of tasks in the deque
+    struct copyTask *top;    //the oldest task, which is stolen by the other workers
+    struct copyTask *bottom; //the newest task, which is popped by the owner
+    struct ioBuffer buffer;  //the buffer of the read/write loop of this worker
+    char *direntBuf;         //the buffer for the getdents64 syscall of this worker
+    long direntSize;         //the size of the direntBuf
+    struct inodeOrder byInode; //the order of the entries of the scanned directory with the -I option
+};
+
+/* The global variables for the parallel copy */
+struct worker *workers = NULL;
+int workerCount = 1;          //the number of workers that is selected with the -j option
+int outstandingTasks = 0;     //the number of tasks that are queued or running
+int idleWorkers = 0;          //the number of workers that are looking for a task
+unsigned workEpoch = 0;       //increased whenever a task is pushed, the idle workers sleep on this futex
+struct copyTask *freeTasks = NULL; //the finished tasks, which are reused by the next tasks
+int freeTaskLock = 0;         //the spin lock of the freeTasks
+
 /* The global variables for the custom memory allocating function */
-char *heap;        //the pointer that points the custom heap
-char *brkp = NULL; //the pointer that points the custom break of the heap
-char *endp = NULL; //the pointer that points the end of the custom heap
+char showStats = 0;    //set by the -T option, prints out the usage of the custom heap
+long direntCalls = 0;  //the number of the getdents64 syscalls (printed out with the -T option)
+long direntCount = 0;  //the number of the directory entries that were read by them
+long skippedFiles = 0; //the number of the unchanged files that the incremental mode skipped (printed out with the -T option)
+long deltaFiles = 0;   //the number of the files that were updated by the block delta
+long deltaBlocks = 0;  //the number of the blocks that the block delta compared
+long changedBlocks = 0; //the number of the blocks that the block delta rewrote
+long verifiedFiles = 0; //the number of the files whose checksums were compared (the -V and -c options)
+long failedFiles = 0;   //the number of the files whose checksums did not match (or could not be read)
+int manifestFd = -1;    //the file descriptor of the manifest (the -M option)
+char hardwareCrc = 0;   //set when the cpu has the crc32 instruction (SSE4.2)
+unsigned int crcTable[8][256]; //the tables of the slicing-by-8 CRC-32C, for the cpus without the SSE4.2
 
-/* preprocessors for the custom malloc function */
-#define MAX_HEAP_SIZE 4194304 //1024 * 4096
-#define CUSTOM_PROT (PROT_READ | PROT_WRITE)
-#define MMAP_FLAG (MAP_PRIVATE | MAP_ANONYMOUS)
+/**
+ * This is a wrapper function of fchmod syscall.
+ * Basically, this function changes the file permission mode of the opened file.
+ *
+ * @param fd the file descriptor of the file
+ * @param mode the new file permission mode
+ * @return On success, zero is returned. Otherwise, some negative value will be returned.
+ */
+int my_fchmod(long fd, mode_t mode) {
+    return syscall2(FCHMOD_SYSCALL, fd, mode);
+}
 
 /**
- * This function initialises the global variables for the custom memory allocating function.
- * The mmap syscall is used to initialise the custom heap memory.
+ * This function fills the given memory with zero bytes.
+ *
+ * @param ptr the pointer that points the memory
+ * @param length the number of bytes to clear
  */
-void initHeap() {
-    char *ptr = NULL;
-    unsigned long fd = -1;
-    unsigned long offset = 0;
+void clearMemory(void *ptr, long length) {
+    char *p = (char *) ptr;
+
+    for (long i = 0; i < length; i++) {
+        p[i] = 0;
+    }
+}
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) MMAP_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == NULL
-        "movq %3, %%rsi\n\t" // %3 == (unsigned long) MAX_HEAP_SIZE
-        "movq %4, %%rdx\n\t" // %4 == (unsigned long) CUSTOM_PROT
-        "movq %5, %%r10\n\t" // %5 == (unsigned long) MMAP_FLAG
-        "movq %6, %%r8\n\t"  // %6 == fd
-        "movq %7, %%r9\n\t"  // %7 == offset
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ptr
-        : "=r"(ptr)          /* if the syscall success, the memory address of the mapped memory will be stored in the ptr */
-        : "r"((long)MMAP_SYSCALL), "r"(NULL), "r"((unsigned long)MAX_HEAP_SIZE), "r"((unsigned long)CUSTOM_PROT), "r"((unsigned long)MMAP_FLAG), "r"(fd), "r"(offset)
-        : "%rax", "%rdi", "%rsi", "%rdx", "%r10", "%r8", "%r9", "memory");
+/**
+ * This function uses the stat syscall to check if the file with the given name is a directory or a file.
+ *
+ * @param name the name of the file (or directory)
+ * @param statBuffer the buffer to store the file stat
+ * @return If the stat syscall fails, returns -1. If the given file is a directory, returns 1. Otherwise, returns 0.
+ */
+int checkFileStat(char *name, struct stat *statBuffer) {
+    return syscall2(STAT_SYSCALL, (long) name, (long) statBuffer);
+}
 
-    heap = ptr;
-    brkp = ptr;
-    endp = ptr + MAX_HEAP_SIZE;
+/**
+ * This function is a wrapper function of the newfstatat syscall.
+ * The name is looked up relative to the opened directory, so the kernel does not walk the whole path again.
+ *
+ * @param dirFd the file descriptor of the directory (or AT_FDCWD)
+ * @param name the name of the file in that directory
+ * @param statBuffer the buffer to store the file stat
+ * @param flags 0 or AT_SYMLINK_NOFOLLOW
+ * @return On success, zero is returned. On error, -errno will be returned.
+ */
+int checkFileStatAt(long dirFd, char *name, struct stat *statBuffer, long flags) {
+    return syscall4(NEWFSTATAT_SYSCALL, dirFd, (long) name, (long) statBuffer, flags);
 }
 
 /**
- * This function is a wrapper function of the munmap system call.
- * The aim of this function is to unmap the mapped memory by using the syscall munmap.
+ * Prints out the given text via stdout stream.
  *
- * @return ret If the munmap syscall success, returns 0. Otherwise, returns -1.
+ * @param text the text
+ * @return If the write syscall success, returns 1. Otherwise, returns -1.
  */
-int myUnMap() {
-    long ret = -1;
+int printOut(const char *text) {
+    long l = 1; //1 for stdout
+    return writeText(text, l);
+}
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) MUNMAP_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == (unsigned long) heap
-        "movq %3, %%rsi\n\t" // %3 == (unsigned long) MAX_HEAP_SIZE
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)MUNMAP_SYSCALL), "r"((unsigned long)heap), "r"((unsigned long)MAX_HEAP_SIZE)
-        : "%rax", "%rdi", "%rsi", "memory");
+/**
+ * This function is a wrapper function of openat system call.
+ * The name is looked up relative to the opened directory, so the kernel does not walk the whole path again.
+ *
+ * @param dirFd the file descriptor of the directory (or AT_FDCWD)
+ * @param name the name of the file (or directory) in that directory
+ * @param flags the flags of the openat syscall (i.e. O_RDONLY, CREATE_FLAG, DIR_FLAG)
+ * @param mode the file permission mode of the new file
+ * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. On error, -errno will be returned.
+ */
+int openAt(long dirFd, char *name, long flags, long mode) {
+    return syscall4(OPENAT_SYSCALL, dirFd, (long) name, flags, mode);
+}
 
-    return ret;
+/**
+ * This function is a wrapper function of the unlinkat syscall.
+ * This function removes the file from the file system.
+ *
+ * @param dirFd the file descriptor of the directory that contains the file
+ * @param name the name of the target file in that directory
+ * @param flags 0 for the file, or AT_REMOVEDIR for the empty directory
+ * @return On success, 0 is returned. On error, some negative value will be returned.
+ */
+int removeFileAt(long dirFd, char *name, long flags) {
+    return syscall3(UNLINKAT_SYSCALL, dirFd, (long) name, flags);
+}
+
+/**
+ * This function raises the soft limit of the open file descriptors to the hard limit with the prlimit64 syscall.
+ * The directory walk keeps two file descriptors open for every level (and the parallel copy for every queued
+ * directory), so the deep trees would run out of the default soft limit.
+ */
+void raiseFileLimit() {
+    struct rlimit limit;
+    long ret = syscall4(PRLIMIT64_SYSCALL, 0, RLIMIT_NOFILE, 0, (long) &limit); //get the limit of this process, without setting it
+
+    if (ret < 0 || limit.rlim_cur >= limit.rlim_max) {
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max;
+
+    syscall4(PRLIMIT64_SYSCALL, 0, RLIMIT_NOFILE, (long) &limit, 0); //set the new limit, without getting the old one
+}
+
+/**
+ * This is a wrapper function of the ftruncate syscall.
+ * This function causes the regular file named by the file descriptor to be truncated to a size of precisely length bytes.
+ *
+ * @param fd the file descriptor of the target file
+ * @param length the size to truncate
+ * @return On success, zero is returned. On error, some negative value, which depends to the error number, will be returned.
+ */
+int ftruncateFile(int fd, long length) {
+    return syscall2(FTRUNC_SYSCALL, fd, length);
+}
+
+/**
+ * This is a wrapper function for the mkdir system call.
+ * It creates a new directory with a given name.
+ *
+ * @param name the name of the new directory
+ * @return On success, 0 will be returned. Otherwise, some negative value will be returned.
+ */
+int makeDirectory(char *name) {
+    return syscall2(MKDIR_SYSCALL, (long) name, MKDIR_MODE);
+}
+
+/**
+ * This is a wrapper function for the mkdirat system call.
+ * It creates a new directory in the opened directory.
+ *
+ * @param dirFd the file descriptor of the parent directory
+ * @param name the name of the new directory in that directory
+ * @return On success, 0 will be returned. Otherwise, some negative value will be returned.
+ */
+int makeDirectoryAt(long dirFd, char *name) {
+    return syscall3(MKDIRAT_SYSCALL, dirFd, (long) name, MKDIR_MODE);
+}
+
+/**
+ * This function is a wrapper function of the rmdir system call.
+ * It removes the particular directory.
+ *
+ * @param name the name of the target directory.
+ * @return On success, 0 will be returned. Otherwise, some negative value will be returned.
+ */
+int removeDirectory(char *name) {
+    return syscall1(RMDIR_SYSCALL, (long) name);
+}
+
+/**
+ * This is a wrapper function of the fchown syscall.
+ * The aim of this function is to change the owner of the opened file with the given user id and group id.
+ *
+ * @param fd the file descriptor of the target file
+ * @param uid the new user id
+ * @param gid the new group id
+ * @return On success, zero is returned.
+ *         On error, some negative value would be returned, which depends on the error number of that error.
+ */
+int my_fchown(long fd, long uid, long gid) {
+    return syscall3(FCHOWN_SYSCALL, fd, uid, gid);
+}
+
+/**
+ * This is a wrapper function of the lseek syscall.
+ *
+ * @param fd the file descriptor of the target file
+ * @param offset the offset to seek
+ * @param whence SEEK_SET, SEEK_CUR, SEEK_DATA or SEEK_HOLE
+ * @return On success, the new file offset is returned. On error, -errno will be returned.
+ */
+long seekFile(long fd, long offset, long whence) {
+    return syscall3(LSEEK_SYSCALL, fd, offset, whence);
+}
+
+/**
+ * This is a wrapper function of the ioctl syscall.
+ *
+ * @param fd the file descriptor of the target file
+ * @param request the request code of the ioctl (i.e. FICLONE)
+ * @param arg the argument of the request
+ * @return On success, zero is returned. On error, -errno will be returned.
+ */
+int ioctlFile(long fd, unsigned long request, long arg) {
+    return syscall3(IOCTL_SYSCALL, fd, (long) request, arg);
+}
+
+/**
+ * This is a wrapper function of the copy_file_range syscall.
+ * It copies the data between the files inside the kernel, starting at the current file offsets of both files.
+ *
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param count the maximum number of bytes to copy
+ * @return Returns the number of bytes that were copied. On error, -errno will be returned.
+ */
+long copyFileRange(long readFd, long fd, long count) {
+    //NULL offsets, to use the file offsets of both files (and no flags)
+    return syscall6(COPY_FILE_RANGE_SYSCALL, readFd, 0, fd, 0, count, 0);
+}
+
+/**
+ * This is a wrapper function of the pread64 syscall, which reads at the given offset without moving the file offset.
+ *
+ * @param fd the file descriptor of the opened file
+ * @param buf the buffer to store the bytes
+ * @param len the size of the buffer
+ * @param offset the offset in the file
+ * @return On success, the number of bytes read is returned (0 at the end of the file). On error, -errno will be returned.
+ */
+long readFileAt(long fd, char *buf, long len, long offset) {
+    return syscall4(PREAD64_SYSCALL, fd, (long) buf, len, offset);
+}
+
+/**
+ * This is a wrapper function of the pwrite64 syscall, which writes at the given offset without moving the file offset.
+ *
+ * @param fd the file descriptor of the opened file
+ * @param buf the bytes that should be written
+ * @param len the number of bytes to write
+ * @param offset the offset in the file
+ * @return Returns the number of bytes that were written. On error, -errno will be returned.
+ */
+long writeFileAt(long fd, const char *buf, long len, long offset) {
+    return syscall4(PWRITE64_SYSCALL, fd, (long) buf, len, offset);
+}
+
+/**
+ * This function copies the modified time of the source file to the opened destination file with the utimensat
+ * syscall (with the NULL path, it changes the file of the descriptor, just like the futimens). The access time is not changed.
+ *
+ * @param fd the file descriptor of the destination file
+ * @param stats the file stat of the source file
+ * @return On success, zero is returned. On error, -errno will be returned.
+ */
+int copyModTime(long fd, struct stat *stats) {
+    struct timespec times[2];
+
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1] = stats->st_mtim;
+
+    return syscall4(UTIMENSAT_SYSCALL, fd, 0, (long) times, 0);
 }
 
 /**
- * The aim of this function is to move the break of the custom heap to allocate the memory dynamically.
+ * This function removes the generated directory(if required), and exit the process.
  *
- * To implement this custom sbrk function, I copied some of the codes from the following article.
- * @reference <https://people.kth.se/~johanmon/ose/assignments/maplloc.pdf>
+ * @param generated to check whether the process should remove the directory or not
+ * @param dir the target directory
  */
-void *mysbrk(size_t size) {
-    if (size == 0) {
-        return (void *)brkp;
+void terminateAndRemoveDir(char generated, struct dirNode *dir) {
+    if (generated && dir->parent != NULL) {
+        removeFileAt(dir->parent->dstFd, dir->name, AT_REMOVEDIR);
+    } else if (generated) {
+        removeDirectory(dir->destName);
     }
+    if (workerCount == 1) { //the other workers may still use the heap
+        myUnMap();
+        releaseArena(&linkArena);
+    }
+    exitProcess(0);
+}
+
+/**
+ * This function checks if the given error of a copy tier means that the tier is not supported
+ * for this pair of files, so that the next tier should be tried.
+ *
+ * EXDEV: the files are on different file systems
+ * EOPNOTSUPP, ENOTTY, ENOSYS: the file system (or the kernel) does not support the tier
+ * EINVAL: the tier does not support these files (i.e. the special files, or the unaligned sizes for the FICLONE)
+ *
+ * @param err the result of the syscall (-errno)
+ * @return Returns 1 if the next tier should be tried. Otherwise, returns 0.
+ */
+char isTierFallback(long err) {
+    return err == -EXDEV || err == -EOPNOTSUPP || err == -EINVAL || err == -ENOTTY || err == -ENOSYS;
+}
+
+/**
+ * This function clones the source file into the destination file with the FICLONE ioctl.
+ * On the file systems that support the reflink (i.e. btrfs, XFS), both files share the same extents
+ * until one of them is modified, so no data is copied at all.
+ *
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @return TIER_DONE, TIER_FALLBACK, or -errno on error.
+ */
+long copyViaClone(int readFd, int fd) {
+    long ret = ioctlFile(fd, FICLONE, readFd);
 
-    void *memp = (void *)brkp;
-    brkp += size; //move the brkp to allocate memory
+    if (ret == 0) {
+        return TIER_DONE;
+    }
+    return isTierFallback(ret) ? TIER_FALLBACK : ret;
+}
 
-    if (brkp >= endp) { //to check if there is empty space in the heap
-        brkp -= size; //move back the brkp
-        return NULL;  //returns NULL if there is no free space in the heap
+/**
+ * This function copies the source file into the destination file with the copy_file_range syscall.
+ * The kernel copies the data without passing it through the user space (or lets the file system
+ * copy it by itself, i.e. the server side copy of the NFS).
+ * If the kernel refuses the rest of the file, the file offsets of both files and the remaining
+ * number of bytes tell the next tier where to continue.
+ *
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param remaining the number of bytes to copy (COPY_UNTIL_EOF for the whole file), which is decreased while copying
+ * @return TIER_DONE, TIER_FALLBACK, or -errno on error.
+ */
+long copyViaRange(int readFd, int fd, long *remaining) {
+    while (*remaining > 0) {
+        long ret = copyFileRange(readFd, fd, (*remaining < COPY_RANGE_CHUNK) ? *remaining : COPY_RANGE_CHUNK);
+
+        if (ret == 0) { //end of file
+            return TIER_DONE;
+        } else if (ret > 0) {
+            *remaining -= ret;
+        } else if (ret != -EINTR) {
+            return isTierFallback(ret) ? TIER_FALLBACK : ret;
+        }
     }
 
-    return memp;
+    return TIER_DONE;
 }
 
 /**
- * This is a wrapper function of chmod syscall.
- * Basically, this function changes the file permission mode of the particular file.
+ * This function checks if the given block contains only the zero bytes.
+ * The block buffer is mapped with the mmap syscall, so the blocks are aligned for the 8 bytes loads.
  *
- * @param name the path name of the file
- * @param mode the new file permission mode
- * @return On success, zero is returned. Otherwise, some negative value will be returned.
+ * @param block the pointer that points the block
+ * @param length the number of bytes in the block
+ * @return Returns 1 if every byte is zero. Otherwise, returns 0.
  */
-int my_chmod(char *name, mode_t mode) {
-    long ret = -1;
+char isZeroBlock(const char *block, long length) {
+    const unsigned long *words = (const unsigned long *) block;
+    long i;
+
+    for (i = 0; i < length / 8; i++) {
+        if (words[i] != 0) {
+            return 0;
+        }
+    }
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) CHMOD_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = name
-        "movq %3, %%rsi\n\t" // %3 = mode
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) CHMOD_SYSCALL), "r"(name), "r"((long)mode)
-        : "%rax", "%rdi", "%rsi", "memory"
-    );
+    for (i *= 8; i < length; i++) {
+        if (block[i] != 0) {
+            return 0;
+        }
+    }
 
-    return ret;
+    return 1;
 }
 
 /**
- * The custom strlen function.
+ * This function checks if the given blocks have the same bytes, by comparing 8 bytes at a time.
+ * Both blocks are in the mapped buffer of the block delta, so they are aligned for the 8 bytes loads.
  *
- * @param str the string to check it's length
- * @return the length of the string
+ * @param block1 the pointer that points the first block
+ * @param block2 the pointer that points the second block
+ * @param length the number of bytes in each block
+ * @return Returns 1 if both blocks are the same. Otherwise, returns 0.
  */
-int strlength(const char *str) {
-    int count = 0;
+char isSameBlock(const char *block1, const char *block2, long length) {
+    const unsigned long *words1 = (const unsigned long *) block1;
+    const unsigned long *words2 = (const unsigned long *) block2;
+    long i;
+
+    for (i = 0; i < length / 8; i++) {
+        if (words1[i] != words2[i]) {
+            return 0;
+        }
+    }
 
-    while (*str != '\0') { //iterate the while loop until it reaches to the terminator character
-        count += 1;
-        str += 1;
+    for (i *= 8; i < length; i++) {
+        if (block1[i] != block2[i]) {
+            return 0;
+        }
     }
 
-    return count;
+    return 1;
+}
+
+/**
+ * This function chooses the kernel of the CRC-32C with the cpuid instruction, and builds the tables of the
+ * slicing-by-8 kernel for the cpus without the SSE4.2. Both kernels compute the same CRC-32C,
+ * so the manifest that is written on one machine could be checked on the other machines.
+ */
+void initChecksum() {
+    unsigned int eax = 1, ebx, ecx = 0, edx;
+
+    asm volatile("cpuid"
+        : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+
+    hardwareCrc = (ecx & CPUID_SSE42) != 0;
+
+    for (unsigned int i = 0; i < 256; i++) {
+        unsigned int crc = i;
+
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        crcTable[0][i] = crc;
+    }
+
+    for (int i = 0; i < 256; i++) { //each table advances the CRC of the previous table by one more zero byte
+        for (int t = 1; t < 8; t++) {
+            crcTable[t][i] = (crcTable[t - 1][i] >> 8) ^ crcTable[0][crcTable[t - 1][i] & 0xff];
+        }
+    }
 }
 
 /**
- * The aim of this function is to copy the string to the new string.
+ * This function updates the CRC-32C with the crc32 instruction of the SSE4.2, 8 bytes at a time.
  *
- * @param str the pointer that points the new string
- * @param s the pointer that points the string that contains the value that should be copied
- * @param length the length of the string that should be copied
+ * @param crc the CRC of the previous bytes (not inverted)
+ * @param data the bytes
+ * @param length the number of bytes
+ * @return the CRC of the previous bytes and the given bytes
  */
-void strcopy(char *str, const char *s, int length) {
-    for (int i = 0; i < length; i++) {
-        *str = *s;
-        str += 1;
-        s += 1;
+unsigned int checksumHardware(unsigned int crc, const char *data, long length) {
+    unsigned long value = crc;
+    long i;
+
+    for (i = 0; i + 8 <= length; i += 8) {
+        asm("crc32q %1, %0"
+            : "+r"(value)
+            : "rm"(*(const unsigned long *) (data + i)));
+    }
+
+    for (; i < length; i++) {
+        asm("crc32b %1, %k0"
+            : "+r"(value)
+            : "rm"(data[i]));
     }
+
+    return (unsigned int) value;
 }
 
 /**
- * This function concatenates 2 given strings.
+ * This function updates the CRC-32C with the slicing-by-8 tables, 8 bytes at a time (for the cpus without the SSE4.2).
  *
- * @param str1 the pointer that points the first string
- * @param str2 the pointer that points the second string
- * @return newStr the pointer that points the concatenated string
+ * @param crc the CRC of the previous bytes (not inverted)
+ * @param data the bytes
+ * @param length the number of bytes
+ * @return the CRC of the previous bytes and the given bytes
  */
-char *strconcat(const char *str1, const char *str2) {
-    int length1 = strlength(str1);      //check the length of the first string
-    int length2 = strlength(str2);      //check the length of the second string
-    int length = length1 + length2 + 1; // add 1 for the terminator.
+unsigned int checksumSoftware(unsigned int crc, const char *data, long length) {
+    const unsigned char *bytes = (const unsigned char *) data;
+    long i;
 
-    char *newStr = (char *)mysbrk(length); //dynamically allocate the memory to concatenate strings
-    char *temp = newStr;
+    for (i = 0; i + 8 <= length; i += 8) {
+        unsigned int low = crc ^ *(const unsigned int *) (bytes + i);
+        unsigned int high = *(const unsigned int *) (bytes + i + 4);
 
-    strcopy(temp, str1, length1); //copy the characters in the first string to the new string
-    temp += length1;
+        crc = crcTable[7][low & 0xff] ^ crcTable[6][(low >> 8) & 0xff] ^ crcTable[5][(low >> 16) & 0xff] ^ crcTable[4][low >> 24]
+            ^ crcTable[3][high & 0xff] ^ crcTable[2][(high >> 8) & 0xff] ^ crcTable[1][(high >> 16) & 0xff] ^ crcTable[0][high >> 24];
+    }
 
-    strcopy(temp, str2, length2); //copy the characters in the second string to the new string
-    temp += length2;
+    for (; i < length; i++) {
+        crc = (crc >> 8) ^ crcTable[0][(crc ^ bytes[i]) & 0xff];
+    }
 
-    *temp = '\0'; //append the terminator at the end of the new string
+    return crc;
+}
 
-    return newStr;
+/**
+ * This function updates the CRC-32C with the kernel that the initChecksum() chose.
+ *
+ * @param crc the CRC of the previous bytes (not inverted)
+ * @param data the bytes
+ * @param length the number of bytes
+ * @return the CRC of the previous bytes and the given bytes
+ */
+unsigned int updateChecksum(unsigned int crc, const char *data, long length) {
+    return hardwareCrc ? checksumHardware(crc, data, length) : checksumSoftware(crc, data, length);
 }
 
 /**
- * This function compares the two strings.
+ * This function updates the CRC-32C with the given number of zero bytes (the holes that the sparse mode skips).
  *
- * @param str1 the pointer that points to the first string
- * @param str2 the pointer that points to the second string
+ * @param crc the CRC of the previous bytes (not inverted)
+ * @param length the number of zero bytes
+ * @return the CRC of the previous bytes and the zero bytes
+ */
+unsigned int updateChecksumZeros(unsigned int crc, long length) {
+    static const char zeroBlock[ZERO_BLOCK_SIZE];
+
+    while (length > 0) {
+        long block = (length < ZERO_BLOCK_SIZE) ? length : ZERO_BLOCK_SIZE;
+
+        crc = updateChecksum(crc, zeroBlock, block);
+        length -= block;
+    }
+
+    return crc;
+}
+
+/**
+ * This function writes the given buffer, but skips the zero blocks with the lseek syscall instead of writing them.
+ * It is used only when the destination file was already sized with the ftruncate syscall,
+ * so the skipped blocks stay as holes in the destination file.
  *
- * @return Returns an integer less than, equal to, or greater than zero if str1 is found, 
- *         respectively, to be less than, to match, or be greater than str2.
+ * @param fd the file descriptor of the destination file
+ * @param buf the bytes that should be written
+ * @param len the number of bytes to write
+ * @return Returns len on success. On error, -errno will be returned.
  */
-int strCompare(const char *str1, const char *str2) {
-    int i = 0;
+long writeSkippingZeros(int fd, const char *buf, long len) {
+    long start = 0; //the start of the run of the non-zero blocks that is not written yet
+    long pos = 0;
+
+    while (pos < len) {
+        long block = (len - pos < ZERO_BLOCK_SIZE) ? len - pos : ZERO_BLOCK_SIZE;
+
+        if (isZeroBlock(buf + pos, block)) {
+            if (pos > start) {
+                long ret = writeBytes(fd, buf + start, pos - start);
+                if (ret < 0) {
+                    return ret;
+                }
+            }
 
-    while (str1[i] != '\0') {
-        if (str1[i] != str2[i]) {
-            break;
+            long ret = seekFile(fd, block, SEEK_CUR); //leave a hole
+            if (ret < 0) {
+                return ret;
+            }
+            start = pos + block;
+        }
+        pos += block;
+    }
+
+    if (pos > start) {
+        long ret = writeBytes(fd, buf + start, pos - start);
+        if (ret < 0) {
+            return ret;
         }
-        i+= 1;
     }
 
-    return (str1[i] - str2[i]);
+    return len;
 }
 
 /**
- * This function uses the stat syscall to check if the file with the given name is a directory or a file.
+ * This function copies the source file into the destination file via the user space buffer.
+ * The buffer grows with the file size, so the large files are copied with a few syscalls.
  *
- * @param name the name of the file (or directory)
- * @param statBuffer the buffer to store the file stat
- * @return If the stat syscall fails, returns -1. If the given file is a directory, returns 1. Otherwise, returns 0.
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param fileSize the size of the source file, which is used for choosing the size of the buffer
+ * @param remaining the number of bytes to copy (COPY_UNTIL_EOF for the whole file), which is decreased while copying
+ * @param buffer the buffer of the read/write loop
+ * @return TIER_DONE, or -errno on error.
  */
-int checkFileStat(char *name, struct stat *statBuffer) {
-    long ret = -1;
+long copyViaReadWrite(int readFd, int fd, long fileSize, long *remaining, struct ioBuffer *buffer) {
+    if (reserveBuffer(buffer, chooseBufferSize(fileSize)) < 0) {
+        return -ENOMEM;
+    }
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) STAT_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fileName
-        "movq %3, %%rsi\n\t" // %3 = statBuffer
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)STAT_SYSCALL), "r"(name), "r"(statBuffer) //covert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "memory");
+    while (*remaining > 0) {
+        long length = readFile(readFd, buffer->data, (*remaining < buffer->size) ? *remaining : buffer->size);
 
-    return ret;
+        if (length == -EINTR) {
+            continue;
+        } else if (length < 0) {
+            return length;
+        } else if (length == 0) {
+            return TIER_DONE;
+        }
+
+        if (checksumMode) { //the checksum is computed while the block is in the buffer, so the source file is read only once
+            buffer->digest = updateChecksum(buffer->digest, buffer->data, length);
+        }
+
+        long ret;
+
+        if (zeroDetect) {
+            ret = writeSkippingZeros(fd, buffer->data, length);
+        } else {
+            ret = writeBytes(fd, buffer->data, length);
+        }
+
+        if (ret < 0) {
+            return ret;
+        }
+        *remaining -= length;
+    }
+
+    return TIER_DONE;
 }
 
 /**
- * This function is a wrapper function of the write syscall.
- * This function uses the inline assembly function to make interaction with the kernel more explicit.
- * To implement this function, I reused the given code, which is written by Kasim Terzic.
+ * This function copies the given number of bytes at the current file offsets with the copy_file_range
+ * (if the current copy mode allows it), and then with the read/write loop.
  *
- * @param text the target text that should be printed out
- * @param handle for stdout, 2 for stderr, file handle from open() for files
- * @return ret If the syscall success, returns 1. Otherwise, returns -1.
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param fileSize the size of the source file
+ * @param length the number of bytes to copy (COPY_UNTIL_EOF for the whole file)
+ * @param buffer the buffer of the read/write loop
+ * @return TIER_DONE, or -errno on error.
  */
-int writeText(const char *text, long handle) {
-    size_t len = strlength(text); //Length of our string, which we need to pass to write syscall
-    long ret = -1;                //Return value received from the system call
+long copyStream(int readFd, int fd, long fileSize, long length, struct ioBuffer *buffer) {
+    long ret = TIER_FALLBACK;
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) WRITE_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == handle
-        "movq %3, %%rsi\n\t" // %3 == text
-        "movq %4, %%rdx\n\t" // %4 == len
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ret
-        : "=r"(ret)          /* if the syscall success, 1 will be stored in the ret. */
-        : "r"((long) WRITE_SYSCALL), "r"(handle), "r"(text), "r"(len)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+    /* the zero-block detection and the checksum need to see the data, so they always use the read/write loop */
+    if (!zeroDetect && !checksumMode && fileSize > 0 && (copyMode == MODE_AUTO || copyMode == MODE_RANGE)) {
+        ret = copyViaRange(readFd, fd, &length);
+    }
+
+    if (ret == TIER_FALLBACK) {
+        ret = copyViaReadWrite(readFd, fd, fileSize, &length, buffer);
+    }
 
     return ret;
 }
 
 /**
- * Prints out the given text via stdout stream.
+ * This function copies only the data extents of the source file, which are found with the
+ * lseek(SEEK_DATA) and lseek(SEEK_HOLE). The destination file is sized once with the ftruncate syscall,
+ * so the holes of the source file stay as holes in the destination file.
+ * If the file system does not report the holes, the whole file is a single data extent
+ * (and the zero-block detection could still find the holes).
  *
- * @param text the text
- * @return If the write syscall success, returns 1. Otherwise, returns -1.
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param fileSize the size of the source file
+ * @param buffer the buffer of the read/write loop
+ * @return TIER_DONE, or -errno on error.
  */
-int printOut(const char *text) {
-    long l = 1; //1 for stdout
-    return writeText(text, l);
+long copySparse(int readFd, int fd, long fileSize, struct ioBuffer *buffer) {
+    long ret = ftruncateFile(fd, fileSize);
+
+    if (ret < 0) {
+        return ret;
+    }
+
+    long offset = 0;
+
+    while (offset < fileSize) {
+        long data = seekFile(readFd, offset, SEEK_DATA);
+        long hole;
+
+        if (data == -ENXIO) { //the rest of the file is a hole
+            break;
+        } else if (data < 0) { //the file system does not support the SEEK_DATA
+            data = offset;
+            hole = fileSize;
+        } else {
+            hole = seekFile(readFd, data, SEEK_HOLE);
+        }
+
+        if (data >= fileSize) {
+            break;
+        }
+        if (hole < 0 || hole > fileSize) {
+            hole = fileSize;
+        }
+
+        if (seekFile(readFd, data, SEEK_SET) < 0 || seekFile(fd, data, SEEK_SET) < 0) {
+            return -EIO;
+        }
+
+        if (checksumMode) { //the skipped hole is read as zeros
+            buffer->digest = updateChecksumZeros(buffer->digest, data - offset);
+        }
+
+        ret = copyStream(readFd, fd, fileSize, hole - data, buffer);
+
+        if (ret < 0) {
+            return ret;
+        }
+        offset = hole;
+    }
+
+    if (checksumMode && offset < fileSize) { //the file ends with a hole
+        buffer->digest = updateChecksumZeros(buffer->digest, fileSize - offset);
+    }
+
+    return TIER_DONE;
+}
+
+/**
+ * This function copies the data of the source file with the tiers of the current copy mode.
+ * Each tier falls back to the next one only when the kernel reports that the tier is not supported
+ * for this pair of files. The empty files (and the special files that report the size 0) go
+ * straight to the read/write loop. In the sparse mode, the data extents are copied one by one
+ * after the FICLONE tier, which shares the holes as well.
+ *
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file
+ * @param fileSize the size of the source file
+ * @param buffer the buffer of the read/write loop
+ * @return TIER_DONE, or -errno on error.
+ */
+long copyData(int readFd, int fd, long fileSize, struct ioBuffer *buffer) {
+    long ret = TIER_FALLBACK;
+
+    if (fileSize > 0 && !checksumMode && (copyMode == MODE_AUTO || copyMode == MODE_CLONE)) {
+        ret = copyViaClone(readFd, fd);
+    }
+
+    if (ret != TIER_FALLBACK) {
+        return ret;
+    }
+
+    if (sparseMode && fileSize > 0) {
+        return copySparse(readFd, fd, fileSize, buffer);
+    }
+
+    return copyStream(readFd, fd, fileSize, COPY_UNTIL_EOF, buffer);
+}
+
+/**
+ * This function reads the given number of bytes at the given offset, by retrying the pread64 syscall after a short read.
+ *
+ * @param fd the file descriptor of the opened file
+ * @param buf the buffer to store the bytes
+ * @param len the number of bytes to read
+ * @param offset the offset in the file
+ * @return the number of bytes read (less than len only at the end of the file), or -errno on error.
+ */
+long readBytesAt(int fd, char *buf, long len, long offset) {
+    long done = 0;
+
+    while (done < len) {
+        long ret = readFileAt(fd, buf + done, len - done, offset + done);
+
+        if (ret == -EINTR) {
+            continue;
+        } else if (ret < 0) {
+            return ret;
+        } else if (ret == 0) {
+            break;
+        }
+        done += ret;
+    }
+
+    return done;
+}
+
+/**
+ * This function writes exactly len bytes at the given offset, by retrying the pwrite64 syscall after a short write.
+ *
+ * @param fd the file descriptor of the destination file
+ * @param buf the bytes that should be written
+ * @param len the number of bytes to write
+ * @param offset the offset in the file
+ * @return Returns len on success. On error, -errno will be returned.
+ */
+long writeBytesAt(int fd, const char *buf, long len, long offset) {
+    long written = 0;
+
+    while (written < len) {
+        long ret = writeFileAt(fd, buf + written, len - written, offset + written);
+
+        if (ret == -EINTR) {
+            continue;
+        } else if (ret < 0) {
+            return ret;
+        }
+        written += ret;
+    }
+
+    return written;
+}
+
+/**
+ * This function updates the existing destination file to the source file with the block delta (the -d option).
+ * Both files are read in chunks into the two halves of the buffer, each chunk is compared in blocks of DELTA_BLOCK_SIZE,
+ * and only the runs of the blocks that differ are written back, so an unchanged block of the destination file is never written.
+ * The blocks are compared directly instead of their hashes, since both files are local and both chunks are already in the memory.
+ * The caller truncates the destination file to the size of the source file.
+ *
+ * @param readFd the file descriptor of the source file
+ * @param fd the file descriptor of the destination file (opened for reading and writing)
+ * @param fileSize the size of the source file
+ * @param oldSize the size of the destination file
+ * @param buffer the buffer of the read/write loop, which holds a chunk of both files
+ * @return TIER_DONE, or -errno on error.
+ */
+long copyChangedBlocks(int readFd, int fd, long fileSize, long oldSize, struct ioBuffer *buffer) {
+    if (reserveBuffer(buffer, chooseBufferSize(fileSize) * 2) < 0) {
+        return -ENOMEM;
+    }
+
+    long chunkSize = (buffer->size / 2) & ~((long) DELTA_BLOCK_SIZE - 1);
+    char *data = buffer->data;            //the chunk of the source file
+    char *old = buffer->data + chunkSize; //the same chunk of the destination file
+    long blocks = 0, changed = 0;
+
+    for (long offset = 0; offset < fileSize; offset += chunkSize) {
+        long length = readBytesAt(readFd, data, (fileSize - offset < chunkSize) ? fileSize - offset : chunkSize, offset);
+        long oldLength = (offset < oldSize && length > 0) ? readBytesAt(fd, old, length, offset) : 0;
+
+        if (length < 0 || oldLength < 0) {
+            return (length < 0) ? length : oldLength;
+        } else if (length == 0) { //the source file turned out to be shorter than its stat
+            break;
+        }
+
+        if (checksumMode) {
+            buffer->digest = updateChecksum(buffer->digest, data, length);
+        }
+
+        long start = 0; //the start of the run of the changed blocks that is not written yet
+        long pos = 0;
+
+        while (pos < length) {
+            long block = (length - pos < DELTA_BLOCK_SIZE) ? length - pos : DELTA_BLOCK_SIZE;
+
+            if (pos + block <= oldLength && isSameBlock(data + pos, old + pos, block)) {
+                if (pos > start) {
+                    long ret = writeBytesAt(fd, data + start, pos - start, offset + start);
+                    if (ret < 0) {
+                        return ret;
+                    }
+                }
+                start = pos + block;
+            } else {
+                changed += 1;
+            }
+            blocks += 1;
+            pos += block;
+        }
+
+        if (pos > start) {
+            long ret = writeBytesAt(fd, data + start, pos - start, offset + start);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+
+    __atomic_add_fetch(&deltaBlocks, blocks, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&changedBlocks, changed, __ATOMIC_RELAXED);
+    return TIER_DONE;
+}
+
+/**
+ * This function keeps the given name in the given buffer, since the getdents buffer is reused.
+ * The longer names (i.e. the path names of the command line) are not copied, since they stay valid.
+ *
+ * @param buf the buffer of NAME_SIZE bytes
+ * @param name the name to keep (or NULL)
+ * @return the name that should be used
+ */
+char *keepName(char *buf, char *name) {
+    if (name == NULL) {
+        return NULL;
+    }
+
+    int length = strlength(name);
+
+    if (length >= NAME_SIZE) {
+        return name;
+    }
+
+    strcopy(buf, name, length + 1); //copy the terminator as well
+    return buf;
+}
+
+/**
+ * This function adds a user to the given directory, so that its file descriptors stay open.
+ *
+ * @param node the directory
+ */
+void retainDirNode(struct dirNode *node) {
+    __atomic_add_fetch(&node->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * This function makes a new directory of the walk, which is not opened yet.
+ * The released directories are reused, so the walk does not use the heap for every directory.
+ *
+ * @param parent the parent directory, or NULL for the source directory
+ * @param name the name in the parent directory (the path name for the source directory)
+ * @return the new directory, or NULL if the heap is full
+ */
+struct dirNode *newDirNode(struct dirNode *parent, char *name) {
+    spinLock(&freeNodeLock);
+    struct dirNode *node = freeNodes;
+    if (node != NULL) {
+        freeNodes = node->nextFree;
+    }
+    spinUnlock(&freeNodeLock);
+
+    if (node == NULL && (node = (struct dirNode *) mysbrk(sizeof(struct dirNode))) == NULL) {
+        printErr("mycp: out of memory\n");
+        return NULL;
+    }
+
+    node->parent = parent;
+    node->name = keepName(node->nameBuf, name);
+    node->destName = NULL;
+    node->srcFd = -1;
+    node->dstFd = -1;
+    node->refs = 1;
+
+    if (parent != NULL) {
+        retainDirNode(parent); //the sub-directory is opened relative to its parent
+    }
+
+    return node;
+}
+
+/**
+ * This function removes a user from the given directory.
+ * When the last user releases it, its file descriptors are closed and its parent is released as well.
+ *
+ * @param node the directory
+ */
+void releaseDirNode(struct dirNode *node) {
+    while (node != NULL && __atomic_sub_fetch(&node->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        struct dirNode *parent = node->parent;
+
+        if (node->srcFd >= 0) {
+            closeFile(node->srcFd);
+        }
+        if (node->dstFd >= 0) {
+            closeFile(node->dstFd);
+        }
+
+        spinLock(&freeNodeLock);
+        node->nextFree = freeNodes;
+        freeNodes = node;
+        spinUnlock(&freeNodeLock);
+
+        node = parent;
+    }
+}
+
+/**
+ * This function prints out the path name of the file in the given directory.
+ * The walk itself never needs the path names, so the path is printed from the names of the parent
+ * directories only when an error message needs it (no memory is allocated).
+ *
+ * @param handle for stdout, 2 for stderr
+ * @param dir the directory that contains the file
+ * @param leaf the name of the file, or NULL for the directory itself
+ * @param dest if non-zero, prints the path name in the destination directory
+ * @return Returns 1 if anything was printed. Otherwise, returns 0.
+ */
+char printPath(long handle, struct dirNode *dir, char *leaf, char dest) {
+    char printed = 0;
+
+    if (dir != NULL) {
+        printed = printPath(handle, dir->parent, (dest && dir->parent == NULL) ? dir->destName : dir->name, dest);
+    }
+
+    if (leaf != NULL) {
+        if (printed) {
+            writeText("/", handle);
+        }
+        writeText(leaf, handle);
+        printed = 1;
+    }
+
+    return printed;
+}
+
+/**
+ * This function opens the source directory and the destination directory of the given directory,
+ * relative to the file descriptors of its parent.
+ * The source directory without the name stands for the current working directory (the single file copy).
+ *
+ * @param node the directory
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int openDirNode(struct dirNode *node) {
+    struct dirNode *parent = node->parent;
+
+    if (node->name == NULL) {
+        node->srcFd = AT_FDCWD;
+    } else if ((node->srcFd = openAt(parent ? parent->srcFd : AT_FDCWD, node->name, DIR_FLAG, 0)) < 0) {
+        writeText("mycp: cannot access '", 1);
+        printPath(1, node, NULL, 0);
+        writeText("' : Permission denied\n", 1);
+        return -1;
+    }
+
+    node->dstFd = openAt(parent ? parent->dstFd : AT_FDCWD, parent ? node->name : node->destName, DIR_FLAG, 0);
+
+    if (node->dstFd < 0) {
+        writeText("mycp: cannot access '", 1);
+        printPath(1, node, NULL, 1);
+        writeText("' : Permission denied\n", 1);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * This function reads the given file and computes its CRC-32C. With "-V direct", the file is opened with the O_DIRECT,
+ * so the data is read from the storage instead of the page cache (the kernel writes back the dirty pages of the file first).
+ * If the file system does not support the O_DIRECT, the file is read through the page cache.
+ *
+ * @param dirFd the file descriptor of the directory that contains the file (or AT_FDCWD)
+ * @param name the name of the file in that directory
+ * @param buffer the buffer of the read/write loop, which is aligned to the page for the O_DIRECT
+ * @param digest the pointer to store the CRC-32C of the file
+ * @return On success, returns 0. Otherwise, returns -errno.
+ */
+int readChecksum(long dirFd, char *name, struct ioBuffer *buffer, unsigned int *digest) {
+    int fd = -EINVAL;
+    struct stat stats;
+
+    if (verifyMode == VERIFY_DIRECT) {
+        fd = openAt(dirFd, name, DIRECT_FLAG, 0);
+    }
+    if (fd == -EINVAL) {
+        fd = openAt(dirFd, name, O_RDONLY, 0);
+    }
+    if (fd < 0) {
+        return fd;
+    }
+
+    //the buffer is sized from the file, and its size stays a multiple of the page size (for the O_DIRECT)
+    if (checkFdStat(fd, &stats) < 0 || reserveBuffer(buffer, chooseBufferSize(stats.st_size)) < 0) {
+        closeFile(fd);
+        return -ENOMEM;
+    }
+
+    unsigned int crc = ~0U;
+
+    for (;;) {
+        long length = readFile(fd, buffer->data, buffer->size);
+
+        if (length == -EINTR) {
+            continue;
+        } else if (length < 0) {
+            closeFile(fd);
+            return length;
+        } else if (length == 0) {
+            break;
+        }
+        crc = updateChecksum(crc, buffer->data, length);
+    }
+
+    closeFile(fd);
+    *digest = ~crc;
+    return 0;
+}
+
+/**
+ * This function stores the path of the given file in the given buffer, just like the printPath().
+ *
+ * @param str the position in the buffer to store the path
+ * @param start the start of the path in the buffer
+ * @param end the end of the buffer
+ * @param dir the directory that contains the file
+ * @param leaf the name of the file (or NULL)
+ * @param dest 1 for the destination path, 0 for the source path
+ * @return the end of the path, or NULL if the path does not fit in the buffer
+ */
+char *formatPath(char *str, char *start, char *end, struct dirNode *dir, char *leaf, char dest) {
+    if (dir != NULL) {
+        str = formatPath(str, start, end, dir->parent, (dest && dir->parent == NULL) ? dir->destName : dir->name, dest);
+    }
+
+    if (leaf != NULL && str != NULL) {
+        int length = strlength(leaf);
+
+        if (str + length + 1 >= end) {
+            return NULL;
+        }
+        if (str > start) {
+            *str = '/';
+            str += 1;
+        }
+        strcopy(str, leaf, length);
+        str += length;
+    }
+
+    return str;
+}
+
+/**
+ * This function appends the line of the given file to the manifest (the -M option). Each line has the CRC-32C in
+ * 8 hexadecimal digits, 2 spaces and the path of the destination file, just like the output of the sha256sum.
+ *
+ * @param digest the CRC-32C of the file
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ */
+void writeManifest(unsigned int digest, struct dirNode *dir, char *name) {
+    char line[MANIFEST_LINE_SIZE];
+
+    for (int i = 7; i >= 0; i--) {
+        line[i] = "0123456789abcdef"[digest & 0xf];
+        digest >>= 4;
+    }
+    line[8] = ' ';
+    line[9] = ' ';
+
+    char *end = formatPath(line + 10, line + 10, line + MANIFEST_LINE_SIZE - 1, dir, name, 1);
+
+    if (end == NULL) {
+        writeText("mycp: the path is too long for the manifest '", 1);
+        printPath(1, dir, name, 1);
+        writeText("'\n", 1);
+        return;
+    }
+
+    *end = '\n';
+    writeBytes(manifestFd, line, end + 1 - line); //a single write, so the lines of the workers never interleave
+}
+
+/**
+ * This function finishes the checksum of the copied file (the -V and -M options). With the -V option, the destination
+ * file is read again, and its checksum is compared with the checksum of the data that was copied.
+ * With the -M option, the checksum and the path of the destination file are appended to the manifest.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param buffer the buffer of the read/write loop, which has the checksum of the copied data
+ * @return On success, returns 0. If the checksums are different (or the file could not be read), returns -1.
+ */
+int checkCopy(struct dirNode *dir, char *name, struct ioBuffer *buffer) {
+    unsigned int digest = ~buffer->digest;
+
+    if (verifyMode != VERIFY_NONE) {
+        unsigned int copied;
+
+        __atomic_add_fetch(&verifiedFiles, 1, __ATOMIC_RELAXED);
+
+        if (readChecksum(dir->dstFd, name, buffer, &copied) < 0 || copied != digest) {
+            writeText("mycp: verification failed '", 1);
+            printPath(1, dir, name, 1);
+            writeText("'\n", 1);
+            __atomic_add_fetch(&failedFiles, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+    }
+
+    if (manifestFd >= 0) {
+        writeManifest(digest, dir, name);
+    }
+
+    return 0;
+}
+
+/**
+ * This function converts the given 8 hexadecimal digits to the number.
+ *
+ * @param str the hexadecimal digits
+ * @param num the pointer to store the number
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int parseHex(const char *str, unsigned int *num) {
+    *num = 0;
+
+    for (int i = 0; i < 8; i++) {
+        char c = str[i];
+        int digit;
+
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            return -1;
+        }
+        *num = (*num << 4) | digit;
+    }
+
+    return 0;
+}
+
+/**
+ * This function checks every file in the given manifest (the -c option), so the copies are verified later
+ * with a single read of each file. The paths are opened relative to the current working directory.
+ *
+ * @param name the path of the manifest
+ * @return the number of the files that failed the check, or -1 if the manifest could not be read
+ */
+long checkManifest(char *name) {
+    int fd = openAt(AT_FDCWD, name, O_RDONLY, 0);
+    struct stat stats;
+
+    if (fd < 0 || checkFdStat(fd, &stats) < 0) {
+        if (fd >= 0) {
+            closeFile(fd);
+        }
+        printErr("mycp: cannot access the manifest ");
+        printErr(name);
+        printErr("\n");
+        return -1;
+    }
+
+    char *text = (char *) mysbrk(stats.st_size + 1);
+    long length = 0;
+
+    if (text == NULL) {
+        closeFile(fd);
+        printErr("mycp: out of memory\n");
+        return -1;
+    }
+
+    while (length < stats.st_size) {
+        long ret = readFile(fd, text + length, stats.st_size - length);
+
+        if (ret == -EINTR) {
+            continue;
+        } else if (ret <= 0) {
+            break;
+        }
+        length += ret;
+    }
+    text[length] = '\0';
+    closeFile(fd);
+
+    char *line = text;
+
+    while (*line != '\0') {
+        char *end = line;
+        unsigned int expected, digest;
+
+        while (*end != '\n' && *end != '\0') {
+            end += 1;
+        }
+        char last = (*end == '\0');
+        *end = '\0';
+
+        if (end - line < 11 || parseHex(line, &expected) < 0 || line[8] != ' ' || line[9] != ' ') {
+            writeText("mycp: invalid line in the manifest '", 1);
+            writeText(line, 1);
+            writeText("'\n", 1);
+            failedFiles += 1;
+        } else if (readChecksum(AT_FDCWD, line + 10, &copyBuffer, &digest) < 0) {
+            writeText("mycp: cannot access '", 1);
+            writeText(line + 10, 1);
+            writeText("' : No such file or directory\n", 1);
+            verifiedFiles += 1;
+            failedFiles += 1;
+        } else if (digest != expected) {
+            writeText("mycp: verification failed '", 1);
+            writeText(line + 10, 1);
+            writeText("'\n", 1);
+            verifiedFiles += 1;
+            failedFiles += 1;
+        } else {
+            verifiedFiles += 1;
+        }
+
+        line = last ? end : end + 1;
+    }
+
+    return failedFiles;
+}
+
+/**
+ * This function checks the destination of the given file in the incremental mode (the -i option).
+ * Every file that the incremental mode copies gets the modified time of its source file, so a regular destination file
+ * with the same size and the same modified time (in nanoseconds) has not changed since the last copy.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param stats the file stat of the source file
+ * @param dstStats the buffer to store the file stat of the destination file
+ * @return DEST_MISSING, DEST_CHANGED or DEST_UNCHANGED
+ */
+int checkDestination(struct dirNode *dir, char *name, struct stat *stats, struct stat *dstStats) {
+    if (checkFileStatAt(dir->dstFd, name, dstStats, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(dstStats->st_mode)) {
+        return DEST_MISSING;
+    }
+
+    if (dstStats->st_size == stats->st_size && dstStats->st_mtim.tv_sec == stats->st_mtim.tv_sec
+            && dstStats->st_mtim.tv_nsec == stats->st_mtim.tv_nsec) {
+        return DEST_UNCHANGED;
+    }
+
+    return DEST_CHANGED;
+}
+
+/**
+ * This function updates the changed destination file with the block delta (the -d option), and copies the permission,
+ * the owner and the modified time of the source file to it. The destination file is opened without the O_TRUNC,
+ * so its unchanged blocks are kept as they are.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param stats the file stat of the source file
+ * @param dstStats the file stat of the destination file
+ * @param buffer the buffer of the read/write loop
+ * @return 0 if the file was handled, or -1 if the destination file could not be opened (then it is copied as a new file)
+ */
+int copyDelta(struct dirNode *dir, char *name, struct stat *stats, struct stat *dstStats, struct ioBuffer *buffer) {
+    int fd = openAt(dir->dstFd, name, O_RDWR, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int readFd = openAt(dir->srcFd, name, O_RDONLY, 0);
+
+    if (readFd < 0) {
+        writeText("mycp: cannot access '", 1);
+        printPath(1, dir, name, 0);
+        writeText("' : Permission denied\n", 1);
+        closeFile(fd);
+        return 0;
+    }
+
+    buffer->digest = ~0U;
+    long ret = copyChangedBlocks(readFd, fd, stats->st_size, dstStats->st_size, buffer);
+
+    if (ret >= 0 && dstStats->st_size != stats->st_size) {
+        ret = ftruncateFile(fd, stats->st_size);
+    }
+
+    if (ret < 0) {
+        writeText("mycp: error writing '", 1);
+        printPath(1, dir, name, 1);
+        writeText("'\n", 1);
+    }
+
+    my_fchmod(fd, stats->st_mode);
+    my_fchown(fd, stats->st_uid, stats->st_gid);
+
+    if (checksumMode && ret >= 0) {
+        ret = checkCopy(dir, name, buffer);
+    }
+
+    if (ret >= 0) { //the failed file keeps its old modified time, so that the next run copies it again
+        copyModTime(fd, stats);
+    }
+    __atomic_add_fetch(&deltaFiles, 1, __ATOMIC_RELAXED);
+
+    closeFile(readFd);
+    closeFile(fd);
+    return 0;
+}
+
+/**
+ * This function handles the given file in the incremental mode, before it is copied.
+ * The unchanged files are skipped, and the changed files are updated with the block delta if the -d option is given.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param stats the file stat of the source file
+ * @param buffer the buffer of the read/write loop
+ * @return 1 if the file was handled, or 0 if it should be copied as a new file
+ */
+char syncFile(struct dirNode *dir, char *name, struct stat *stats, struct ioBuffer *buffer) {
+    struct stat dstStats;
+    int state = checkDestination(dir, name, stats, &dstStats);
+
+    if (state == DEST_UNCHANGED) {
+        __atomic_add_fetch(&skippedFiles, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    return (state == DEST_CHANGED && deltaMode && copyDelta(dir, name, stats, &dstStats, buffer) == 0);
+}
+
+/**
+ * This function is a wrapper function of the linkat syscall.
+ * This function creates the new name (hardlink) of the existing file.
+ *
+ * @param oldDirFd the file descriptor of the directory that the old path is relative to (or AT_FDCWD)
+ * @param oldName the path of the existing file
+ * @param newDirFd the file descriptor of the directory that contains the new name
+ * @param newName the new name of the file in that directory
+ * @return On success, 0 is returned. On error, some negative value will be returned.
+ */
+int linkFileAt(long oldDirFd, char *oldName, long newDirFd, char *newName) {
+    return syscall5(LINKAT_SYSCALL, oldDirFd, (long) oldName, newDirFd, (long) newName, 0); //does not follow the symbolic link
+}
+
+/**
+ * This function finds the slot of the given inode in the hardlink table with the linear probing.
+ * The slot index is taken from the high bits of the Fibonacci hash, so the sequential inode numbers are spread out.
+ * The caller should hold the linkLock.
+ *
+ * @param dev the device of the source file
+ * @param ino the inode number of the source file
+ * @return the slot of the inode, or the empty slot where it should be inserted
+ */
+struct linkSlot *findLinkSlot(unsigned long dev, unsigned long ino) {
+    unsigned long index = (((ino ^ (dev * HASH_MULTIPLIER)) * HASH_MULTIPLIER) >> 32) & linkMask;
+
+    while (linkSlots[index].path != NULL && (linkSlots[index].ino != ino || linkSlots[index].dev != dev)) {
+        index = (index + 1) & linkMask;
+    }
+
+    return &linkSlots[index];
+}
+
+/**
+ * This function doubles the number of the slots of the hardlink table (or creates the table), and moves the inodes
+ * into the new slots. The old slots are left in the arena, which is only 24 bytes per inode in total.
+ * The caller should hold the linkLock.
+ *
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int growLinkTable() {
+    struct linkSlot *oldSlots = linkSlots;
+    long oldSize = (oldSlots != NULL) ? linkMask + 1 : 0;
+    long size = (oldSlots != NULL) ? oldSize * 2 : MIN_LINK_SLOTS;
+    struct linkSlot *slots = (struct linkSlot *) allocateFromArena(&linkArena, size * sizeof(struct linkSlot));
+
+    if (slots == NULL) {
+        return -1;
+    }
+    clearMemory(slots, size * sizeof(struct linkSlot)); //the empty slots have no path
+
+    linkSlots = slots;
+    linkMask = size - 1;
+
+    for (long i = 0; i < oldSize; i++) {
+        if (oldSlots[i].path != NULL) {
+            *findLinkSlot(oldSlots[i].dev, oldSlots[i].ino) = oldSlots[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * This function records the first copy of the source file that has more than one link (the -H option),
+ * so that its later links are recreated with the linkat syscall instead of copying the data again.
+ * The path of the copy is kept in the arena until the copy finishes.
+ *
+ * It is called only after the first copy was completely copied (and verified), so the later links never point to
+ * a partial copy. When two workers copy the links of the same inode at the same time, only the first one that
+ * finishes records its copy, and the other one replaces its copy with a link.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param stats the file stat of the source file
+ * @return 0 if the inode was already recorded by the other link, otherwise 1
+ */
+char rememberLink(struct dirNode *dir, char *name, struct stat *stats) {
+    if (!hardlinkMode || stats->st_nlink <= 1 || !S_ISREG(stats->st_mode)) {
+        return 1;
+    }
+
+    char path[PATH_SIZE];
+    char *end = formatPath(path, path, path + PATH_SIZE, dir, name, 1);
+
+    if (end == NULL) { //the path is too long, so the later links are copied
+        return 1;
+    }
+    *end = '\0';
+
+    spinLock(&linkLock);
+
+    if ((linkCount + 1) * 4 > (linkMask + 1) * 3 && growLinkTable() != 0) { //keeps the load factor under 3/4
+        spinUnlock(&linkLock);
+        return 1;
+    }
+
+    struct linkSlot *slot = findLinkSlot(stats->st_dev, stats->st_ino);
+    char first = (slot->path == NULL);
+
+    if (first && (slot->path = (char *) allocateFromArena(&linkArena, end - path + 1)) != NULL) {
+        strcopy(slot->path, path, end - path + 1);
+        slot->ino = stats->st_ino;
+        slot->dev = stats->st_dev;
+        linkCount++;
+    }
+
+    spinUnlock(&linkLock);
+    return first;
+}
+
+/**
+ * This function recreates the later link of the source file whose first copy is in the hardlink table (the -H option).
+ * When the destination already exists, it is replaced by the link, unless it is the same file as the first copy.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the file in that directory
+ * @param stats the file stat of the source file
+ * @return 1 if the file was linked, or 0 if it should be copied (i.e. the first link, or the linkat syscall failed)
+ */
+char linkCopy(struct dirNode *dir, char *name, struct stat *stats) {
+    if (!hardlinkMode || stats->st_nlink <= 1 || !S_ISREG(stats->st_mode)) {
+        return 0;
+    }
+
+    spinLock(&linkLock);
+    char *path = (linkSlots != NULL) ? findLinkSlot(stats->st_dev, stats->st_ino)->path : NULL; //the path is never changed once it is set
+    spinUnlock(&linkLock);
+
+    if (path == NULL) {
+        return 0;
+    }
+
+    int ret = linkFileAt(AT_FDCWD, path, dir->dstFd, name);
+
+    if (ret == -EEXIST) {
+        struct stat first, existing;
+
+        if (checkFileStatAt(AT_FDCWD, path, &first, AT_SYMLINK_NOFOLLOW) == 0
+            && checkFileStatAt(dir->dstFd, name, &existing, AT_SYMLINK_NOFOLLOW) == 0
+            && first.st_ino == existing.st_ino && first.st_dev == existing.st_dev) {
+            ret = 0; //already linked by the previous copy
+        } else if (removeFileAt(dir->dstFd, name, 0) == 0) {
+            ret = linkFileAt(AT_FDCWD, path, dir->dstFd, name);
+        }
+    }
+
+    if (ret != 0) { //e.g. the destination file system does not support the hardlinks, so the file is copied
+        return 0;
+    }
+
+    __atomic_add_fetch(&linkedFiles, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+/**
+ * This function copies the file with the given name in the given directory to the destination directory.
+ * Both files are opened relative to the file descriptors of the directory.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the target file in that directory
+ * @param buffer the buffer of the read/write loop (each worker of the parallel copy has its own buffer)
+ */
+void copyFile(struct dirNode *dir, char *name, struct ioBuffer *buffer) {
+    struct stat stats; // declares struct stat to store stat of argument
+    int stat = checkFileStatAt(dir->srcFd, name, &stats, 0);
+
+    if (stat != 0) { //if the stat syscall fails, some negative value will be returned
+        writeText("mycp: cannot access '", 1);
+        printPath(1, dir, name, 0);
+        writeText("' : No such file or directory\n", 1);
+        return;
+    }
+
+    if (S_ISDIR(stats.st_mode)) { //when the given file is a directory (i.e. a symbolic link to a directory)
+        writeText("mycp: ", 1);
+        printPath(1, dir, name, 0);
+        writeText(": Is a directory\n", 1);
+        return;
+    }
+
+    if (linkCopy(dir, name, &stats)) { //the later link of the file that was already copied
+        return;
+    }
+
+    if (incremental && syncFile(dir, name, &stats, buffer)) { //the destination file is unchanged, or updated with the block delta
+        if (!rememberLink(dir, name, &stats)) { //the other worker recorded the same inode first
+            linkCopy(dir, name, &stats);
+        }
+        return;
+    }
+
+    int fd = openAt(dir->dstFd, name, CREATE_FLAG, CREATE_MODE);
+
+    //if the openAt function returns negative value, it means that the new file could not be created
+    if (fd < 0) {
+        //Print out the error message
+        writeText("mycp: cannot access '", 1);
+        printPath(1, dir, name, 1);
+        writeText("' : Permission denied\n", 1);
+
+        terminateAndRemoveDir(1, dir);
+    }
+
+    int readFd = openAt(dir->srcFd, name, O_RDONLY, 0);
+
+    if (readFd < 0) {
+        //Print out the error message
+        writeText("mycp: cannot access '", 1);
+        printPath(1, dir, name, 0);
+        writeText("' : Permission denied\n", 1);
+
+        removeFileAt(dir->dstFd, name, 0); //use the wrapper function of the unlinkat syscall to remove the file.
+        terminateAndRemoveDir(1, dir);
+    }
+
+    buffer->digest = ~0U; //the CRC-32C starts from all ones
+    long copied = copyData(readFd, fd, stats.st_size, buffer);
+
+    if (copied < 0) {
+        writeText("mycp: error writing '", 1);
+        printPath(1, dir, name, 1);
+        writeText("'\n", 1);
+    }
+
+    /* 
+     * If the size of the original file and new file are different,
+     * truncate the new file with the original file's length
+     * (in the sparse mode, the new file was already sized with the ftruncate syscall)
+     */
+    struct stat newStat;
+
+    if (!sparseMode && checkFdStat(fd, &newStat) == 0 && newStat.st_size != stats.st_size) {
+        ftruncateFile(fd, stats.st_size);
+    }
+
+    //change the file permission of the new file with the file permission mode of the original file.
+    my_fchmod(fd, stats.st_mode);
+
+    //change the user id and group id of the new file with the uid and gid of the original file.
+    my_fchown(fd, stats.st_uid, stats.st_gid);
+
+    //the copy is checked before its modified time is copied, so a copy that failed the verification is copied again by the next run
+    if (checksumMode && copied >= 0) {
+        copied = checkCopy(dir, name, buffer);
+    }
+
+    //in the incremental mode, the modified time is copied last (the ftruncate changes it), and only if the whole file was copied
+    if (incremental && copied >= 0) {
+        copyModTime(fd, &stats);
+    }
+
+    //close the opened files
+    closeFile(readFd);
+    closeFile(fd);
+
+    //only the complete copy is linked by the later links, so a failed copy leaves them to be copied as well
+    if (copied >= 0 && !rememberLink(dir, name, &stats)) { //the other worker recorded the same inode first
+        linkCopy(dir, name, &stats);
+    }
+}
+
+/**
+ * This is a wrapper function of the io_uring_setup syscall.
+ *
+ * @param entries the number of entries of the submission queue
+ * @param params the parameters of the io_uring instance, which are filled in by the kernel
+ * @return On success, the file descriptor of the io_uring instance is returned. On error, -errno will be returned.
+ */
+long uringSetup(unsigned entries, struct io_uring_params *params) {
+    return syscall2(IO_URING_SETUP_SYSCALL, entries, (long) params);
+}
+
+/**
+ * This is a wrapper function of the io_uring_enter syscall.
+ * It submits the queued SQEs, and waits for the given number of completions.
+ *
+ * @param fd the file descriptor of the io_uring instance
+ * @param toSubmit the number of SQEs to submit
+ * @param minComplete the number of completions to wait for
+ * @param flags the flags of the io_uring_enter syscall (i.e. IORING_ENTER_GETEVENTS)
+ * @return On success, the number of submitted SQEs is returned. On error, -errno will be returned.
+ */
+long uringEnter(long fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return syscall6(IO_URING_ENTER_SYSCALL, fd, toSubmit, minComplete, flags, 0, 0); //no signal mask
+}
+
+/**
+ * This function sets up the io_uring instance and maps its rings and the block buffers.
+ * It fails when the kernel does not support io_uring (or it is disabled), and when the kernel is too old
+ * to support the IORING_OP_READ and IORING_OP_WRITE, so that the mycp could fall back to the read/write loop.
+ *
+ * @param depth the queue depth, which is the number of slots that are kept in flight
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int uringInit(int depth) {
+    struct io_uring_params params;
+    clearMemory(&params, sizeof(params));
+
+    long fd = uringSetup(depth, &params);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    /* IORING_FEAT_RW_CUR_POS came with the IORING_OP_READ and IORING_OP_WRITE in Linux 5.6 */
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_RW_CUR_POS)) {
+        closeFile(fd);
+        return -1;
+    }
+
+    ring.fd = fd;
+    ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    if (ring.cqRingSize > ring.sqRingSize) {
+        ring.sqRingSize = ring.cqRingSize; //both rings are mapped with a single mmap
+    }
+    ring.cqRingSize = ring.sqRingSize;
+    ring.sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    long sqRing = mapRegion(ring.sqRingSize, RING_PROT, RING_FLAG, fd, IORING_OFF_SQ_RING);
+    long sqes = mapRegion(ring.sqesSize, RING_PROT, RING_FLAG, fd, IORING_OFF_SQES);
+    long buffers = mapMemory((long) depth * URING_BLOCK_SIZE);
+
+    slots = (struct uringSlot *) mysbrk(depth * sizeof(struct uringSlot));
+    maxActiveJobs = (depth >= 8) ? depth / 4 : 2; //each file gets several slots in flight on average
+    activeJobs = (struct uringJob **) mysbrk(maxActiveJobs * sizeof(struct uringJob *));
+
+    if (sqRing < 0 || sqes < 0 || buffers < 0 || slots == NULL || activeJobs == NULL) {
+        closeFile(fd);
+        return -1;
+    }
+
+    ring.sqRing = (char *) sqRing;
+    ring.cqRing = (char *) sqRing;
+    ring.sqes = (struct io_uring_sqe *) sqes;
+    ring.sqHead = (unsigned *) (ring.sqRing + params.sq_off.head);
+    ring.sqTail = (unsigned *) (ring.sqRing + params.sq_off.tail);
+    ring.sqMask = (unsigned *) (ring.sqRing + params.sq_off.ring_mask);
+    ring.sqArray = (unsigned *) (ring.sqRing + params.sq_off.array);
+    ring.cqHead = (unsigned *) (ring.cqRing + params.cq_off.head);
+    ring.cqTail = (unsigned *) (ring.cqRing + params.cq_off.tail);
+    ring.cqMask = (unsigned *) (ring.cqRing + params.cq_off.ring_mask);
+    ring.cqes = (struct io_uring_cqe *) (ring.cqRing + params.cq_off.cqes);
+    ring.toSubmit = 0;
+
+    for (int i = 0; i < depth; i++) {
+        slots[i].job = NULL;
+        slots[i].data = (char *) buffers + (long) i * URING_BLOCK_SIZE;
+        slots[i].state = SLOT_FREE;
+    }
+
+    queueDepth = depth;
+    return 0;
+}
+
+/**
+ * This function unmaps the rings and the block buffers, and closes the io_uring instance.
+ */
+void uringRelease() {
+    unmapMemory(slots[0].data, (long) queueDepth * URING_BLOCK_SIZE);
+    unmapMemory((char *) ring.sqes, ring.sqesSize);
+    unmapMemory(ring.sqRing, ring.sqRingSize);
+    closeFile(ring.fd);
+}
+
+/**
+ * This function queues the SQE for the current state of the given slot.
+ * A reading slot reads the rest of its block, and a writing slot writes the rest of the read bytes.
+ * The index of the slot is stored in the user_data, so that the completion could find its slot.
+ *
+ * @param index the index of the slot
+ */
+void uringSubmitSlot(int index) {
+    struct uringSlot *slot = &slots[index];
+    unsigned tail = *ring.sqTail;
+    unsigned sqeIndex = tail & *ring.sqMask;
+    struct io_uring_sqe *sqe = &ring.sqes[sqeIndex];
+
+    clearMemory(sqe, sizeof(struct io_uring_sqe));
+
+    if (slot->state == SLOT_READING) {
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot->job->readFd;
+        sqe->addr = (unsigned long) (slot->data + slot->got);
+        sqe->len = slot->length - slot->got;
+        sqe->off = slot->offset + slot->got;
+    } else {
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = slot->job->fd;
+        sqe->addr = (unsigned long) (slot->data + slot->written);
+        sqe->len = slot->got - slot->written;
+        sqe->off = slot->offset + slot->written;
+    }
+    sqe->user_data = index;
+
+    ring.sqArray[sqeIndex] = sqeIndex;
+    __atomic_store_n(ring.sqTail, tail + 1, __ATOMIC_RELEASE); //publish the SQE to the kernel
+    ring.toSubmit += 1;
+}
+
+/**
+ * This function finishes copying the given file.
+ * It changes the permission and the owner of the new file, closes the opened files, and releases its directory.
+ *
+ * @param job the file that should be finished
+ */
+void uringFinishJob(struct uringJob *job) {
+    for (int i = 0; i < activeCount; i++) { //remove the file from the active files
+        if (activeJobs[i] == job) {
+            activeCount -= 1;
+            activeJobs[i] = activeJobs[activeCount];
+            break;
+        }
+    }
+
+    if (!job->failed) {
+        //change the file permission of the new file with the file permission mode of the original file.
+        my_fchmod(job->fd, job->stats.st_mode);
+
+        //change the user id and group id of the new file with the uid and gid of the original file.
+        my_fchown(job->fd, job->stats.st_uid, job->stats.st_gid);
+
+        if (incremental) {
+            copyModTime(job->fd, &job->stats);
+        }
+    }
+
+    if (job->readFd >= 0) {
+        closeFile(job->readFd);
+    }
+    if (job->fd >= 0) {
+        closeFile(job->fd);
+    }
+
+    releaseDirNode(job->dir);
+    job->next = freeJobs; //the job is reused by the next file
+    freeJobs = job;
+}
+
+/**
+ * This function opens the first file in the pending queue, and adds it to the active files.
+ * Empty files and the files that could not be opened are finished immediately.
+ */
+void uringActivateJob() {
+    struct uringJob *job = pendingHead;
+
+    pendingHead = job->next;
+    if (pendingHead == NULL) {
+        pendingTail = NULL;
+    }
+    pendingCount -= 1;
+
+    job->fd = openAt(job->dir->dstFd, job->name, CREATE_FLAG, CREATE_MODE);
+    job->readFd = openAt(job->dir->srcFd, job->name, O_RDONLY, 0);
+
+    if (job->fd < 0) {
+        writeText("mycp: cannot access '", 1);
+        printPath(1, job->dir, job->name, 1);
+        writeText("' : Permission denied\n", 1);
+        job->failed = 1;
+    } else if (job->readFd < 0) {
+        writeText("mycp: cannot access '", 1);
+        printPath(1, job->dir, job->name, 0);
+        writeText("' : Permission denied\n", 1);
+        removeFileAt(job->dir->dstFd, job->name, 0);
+        job->failed = 1;
+    }
+
+    if (job->failed || job->size == 0) {
+        uringFinishJob(job);
+        return;
+    }
+
+    activeJobs[activeCount] = job;
+    activeCount += 1;
+}
+
+/**
+ * This function chooses the file that gets the next free slot.
+ * The active files share the slots in round robin order, and a new file is opened when
+ * every active file has all of its blocks in flight.
+ *
+ * @return the file that should be read next, or NULL if there is no block left to read
+ */
+struct uringJob *uringNextJob() {
+    for (;;) {
+        for (int i = 0; i < activeCount; i++) {
+            int index = (roundRobin + i) % activeCount;
+            struct uringJob *job = activeJobs[index];
+
+            if (!job->eof && !job->failed && job->nextOffset < job->size) {
+                roundRobin = index + 1;
+                return job;
+            }
+        }
+
+        if (activeCount >= maxActiveJobs || pendingHead == NULL) {
+            return NULL;
+        }
+
+        uringActivateJob();
+    }
+}
+
+/**
+ * This function gives a block of the active files to every free slot, and queues their read SQEs.
+ */
+void uringFill() {
+    for (int i = 0; i < queueDepth; i++) {
+        if (slots[i].state != SLOT_FREE) {
+            continue;
+        }
+
+        struct uringJob *job = uringNextJob();
+
+        if (job == NULL) {
+            break;
+        }
+
+        long length = job->size - job->nextOffset;
+
+        slots[i].job = job;
+        slots[i].offset = job->nextOffset;
+        slots[i].length = (length < URING_BLOCK_SIZE) ? length : URING_BLOCK_SIZE;
+        slots[i].got = 0;
+        slots[i].written = 0;
+        slots[i].state = SLOT_READING;
+
+        job->nextOffset += slots[i].length;
+        job->pending += 1;
+        uringSubmitSlot(i);
+    }
+}
+
+/**
+ * This function frees the given slot, and finishes its file if this was the last block of that file.
+ *
+ * @param index the index of the slot
+ */
+void uringReleaseSlot(int index) {
+    struct uringJob *job = slots[index].job;
+
+    slots[index].state = SLOT_FREE;
+    slots[index].job = NULL;
+    job->pending -= 1;
+
+    if (job->pending == 0 && (job->failed || job->eof || job->nextOffset >= job->size)) {
+        uringFinishJob(job);
+    }
+}
+
+/**
+ * This function handles the completion of the SQE of the given slot.
+ * The short reads and the short writes are resubmitted for the rest of the block.
+ *
+ * @param index the index of the slot
+ * @param res the result of the SQE (the number of bytes, or -errno)
+ */
+void uringComplete(int index, int res) {
+    struct uringSlot *slot = &slots[index];
+
+    if (res == -EINTR || res == -EAGAIN) {
+        uringSubmitSlot(index);
+        return;
+    }
+
+    if (res < 0 || (res == 0 && slot->state == SLOT_WRITING)) {
+        writeText("mycp: error copying '", 1);
+        printPath(1, slot->job->dir, slot->job->name, 0);
+        writeText("'\n", 1);
+        slot->job->failed = 1;
+        uringReleaseSlot(index);
+        return;
+    }
+
+    if (slot->state == SLOT_READING) {
+        if (res == 0) { //the source file became shorter than its stat
+            slot->job->eof = 1;
+            slot->length = slot->got;
+        }
+        slot->got += res;
+
+        if (slot->got < slot->length) {
+            uringSubmitSlot(index);
+        } else if (slot->got == 0) {
+            uringReleaseSlot(index);
+        } else {
+            slot->state = SLOT_WRITING;
+            uringSubmitSlot(index);
+        }
+    } else {
+        slot->written += res;
+
+        if (slot->written < slot->got) {
+            uringSubmitSlot(index);
+        } else {
+            uringReleaseSlot(index);
+        }
+    }
+}
+
+/**
+ * This function submits the queued SQEs and handles every completion in the completion queue.
+ *
+ * @param wait if non-zero, waits for at least one completion
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int uringReap(int wait) {
+    long ret;
+
+    do {
+        ret = uringEnter(ring.fd, ring.toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0);
+    } while (ret == -EINTR);
+
+    if (ret < 0) {
+        return -1;
+    }
+    ring.toSubmit -= ret;
+
+    unsigned head = *ring.cqHead;
+    unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+        int index = (int) cqe->user_data;
+        int res = cqe->res;
+
+        head += 1;
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE); //give the CQE back to the kernel
+
+        uringComplete(index, res);
+    }
+
+    return 0;
+}
+
+/**
+ * This function checks if any slot of the io_uring copy engine is in flight.
+ *
+ * @return Returns 1 if there is a slot in flight. Otherwise, returns 0.
+ */
+char uringBusy() {
+    for (int i = 0; i < queueDepth; i++) {
+        if (slots[i].state != SLOT_FREE) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * This function adds the file to the pending queue of the io_uring copy engine.
+ * It keeps the engine running while the directory walk goes on, and only waits for the engine
+ * when too many files are waiting in the pending queue.
+ *
+ * The file holds its directory, so the directory stays open until the file is copied.
+ *
+ * @param dir the directory that contains the file
+ * @param name the name of the target file in that directory
+ */
+void uringQueueFile(struct dirNode *dir, char *name) {
+    struct stat stats;
+
+    if (checkFileStatAt(dir->srcFd, name, &stats, 0) != 0) { //if the stat syscall fails, some negative value will be returned
+        writeText("mycp: cannot access '", 1);
+        printPath(1, dir, name, 0);
+        writeText("' : No such file or directory\n", 1);
+        return;
+    }
+
+    if (S_ISDIR(stats.st_mode)) { //when the given file is a directory (i.e. a symbolic link to a directory)
+        writeText("mycp: ", 1);
+        printPath(1, dir, name, 0);
+        writeText(": Is a directory\n", 1);
+        return;
+    }
+
+    //the files with more than one link are handled at once, so that their later links find the first copy in the table
+    if (hardlinkMode && stats.st_nlink > 1 && S_ISREG(stats.st_mode)) {
+        copyFile(dir, name, &copyBuffer);
+        return;
+    }
+
+    //the unchanged files are skipped, and the block delta runs in place (with the buffer of the read/write loop)
+    if (incremental && syncFile(dir, name, &stats, &copyBuffer)) {
+        return;
+    }
+
+    struct uringJob *job = freeJobs;
+
+    if (job != NULL) {
+        freeJobs = job->next;
+    } else if ((job = (struct uringJob *) mysbrk(sizeof(struct uringJob))) == NULL) {
+        printErr("mycp: out of memory\n");
+        return;
+    }
+
+    job->stats = stats;
+    retainDirNode(dir);
+    job->dir = dir;
+    job->name = keepName(job->nameBuf, name);
+    job->readFd = -1;
+    job->fd = -1;
+    job->size = job->stats.st_size;
+    job->nextOffset = 0;
+    job->pending = 0;
+    job->eof = 0;
+    job->failed = 0;
+    job->next = NULL;
+
+    if (pendingTail == NULL) {
+        pendingHead = job;
+    } else {
+        pendingTail->next = job;
+    }
+    pendingTail = job;
+    pendingCount += 1;
+
+    uringReap(0); //submit the queued SQEs and handle the completions without waiting
+    uringFill();
+
+    while (pendingCount > URING_MAX_PENDING && uringBusy()) {
+        if (uringReap(1) < 0) {
+            break;
+        }
+        uringFill();
+    }
+}
+
+/**
+ * This function waits until every queued file is copied.
+ */
+void uringDrain() {
+    uringFill();
+
+    while (uringBusy()) {
+        if (uringReap(1) < 0) {
+            break;
+        }
+        uringFill();
+    }
+}
+
+/**
+ * This function is a wrapper function of the getdents64 system call.
+ * The system call getdents64() reads several linux_dirent64 structures from
+ * the directory referred to by the open file descriptor into the buffer.
+ *
+ * @param fd the file descriptor of the directory
+ * @param buf the buffer to store the linux_dirent64 structures
+ * @param size the size of the buffer
+ * @return On success, the number of bytes read is returned. On end of directory, 0 is returned. On error, -errno will be returned.
+ */
+long getDents(long fd, char *buf, long size) {
+    return syscall3(GETDENTS64_SYSCALL, fd, (long) buf, size);
+}
+
+/**
+ * This function makes sure that the given getdents64 buffer is big enough for the given directory.
+ * The size is chosen from the st_size of the directory: it starts from MIN_DIRENT_BUFFER and doubles
+ * until it covers twice the st_size (the linux_dirent64 is bigger than the entry on the disk) or reaches
+ * MAX_DIRENT_BUFFER, so most directories are read with a single syscall. The buffer only grows,
+ * so it is reused by the following directories.
+ *
+ * @param buf the pointer to the buffer (NULL if there is no buffer yet)
+ * @param bufSize the pointer to the size of the buffer
+ * @param fd the file descriptor of the directory
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int reserveDirentBuffer(char **buf, long *bufSize, long fd) {
+    struct stat stats;
+    long size = MIN_DIRENT_BUFFER;
+
+    if (checkFdStat(fd, &stats) == 0) {
+        while (size < stats.st_size * 2 && size < MAX_DIRENT_BUFFER) {
+            size *= 2;
+        }
+    }
+
+    if (*buf != NULL && *bufSize >= size) {
+        return 0;
+    }
+
+    char *grown = (char *) mysbrk(size);
+
+    if (grown == NULL) {
+        printErr("mycp: out of memory\n");
+        return (*buf != NULL) ? 0 : -1; //keep using the smaller buffer if there is one
+    }
+
+    *buf = grown;
+    *bufSize = size;
+    return 0;
+}
+
+/**
+ * This function counts the getdents64 syscalls and the entries that they returned, so that the
+ * batching of the directory reads could be checked with the -T option.
+ *
+ * @param calls the number of syscalls
+ * @param entries the number of entries
+ */
+void countDirents(long calls, long entries) {
+    __atomic_add_fetch(&direntCalls, calls, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&direntCount, entries, __ATOMIC_RELAXED);
+}
+
+/**
+ * This function prints out the number of the getdents64 syscalls and the entries via stderr stream (the -T option).
+ */
+void printDirentStats() {
+    char num[21];
+
+    printErr("mycp getdents64: ");
+    printErr(formatNumber(direntCalls, num));
+    printErr(" calls, ");
+    printErr(formatNumber(direntCount, num));
+    printErr(" entries, ");
+    printErr(formatNumber(direntCalls > 0 ? direntCount / direntCalls : 0, num));
+    printErr(" entries per call\n");
+}
+
+/**
+ * This function prints out the number of the skipped files and the blocks of the block delta via stderr stream (the -T option with -i).
+ */
+void printSyncStats() {
+    char num[21];
+
+    printErr("mycp incremental: ");
+    printErr(formatNumber(skippedFiles, num));
+    printErr(" unchanged files skipped, ");
+    printErr(formatNumber(deltaFiles, num));
+    printErr(" files updated by the block delta (");
+    printErr(formatNumber(changedBlocks, num));
+    printErr(" of ");
+    printErr(formatNumber(deltaBlocks, num));
+    printErr(" blocks rewritten)\n");
+}
+
+/**
+ * This function prints out the number of the verified files and the files that failed the verification via stderr stream
+ * (the -T option with -V or -c).
+ */
+void printVerifyStats() {
+    char num[21];
+
+    printErr("mycp verify: ");
+    printErr(formatNumber(verifiedFiles, num));
+    printErr(" files verified with the ");
+    printErr(hardwareCrc ? "SSE4.2" : "slicing-by-8");
+    printErr(" CRC-32C, ");
+    printErr(formatNumber(failedFiles, num));
+    printErr(" failed\n");
+}
+
+/**
+ * This function prints out the number of the linked files and the size of the hardlink table via stderr stream (the -T option with -H).
+ */
+void printLinkStats() {
+    char num[21];
+
+    printErr("mycp hardlinks: ");
+    printErr(formatNumber(linkedFiles, num));
+    printErr(" files linked, ");
+    printErr(formatNumber(linkCount, num));
+    printErr(" inodes in ");
+    printErr(formatNumber(linkSlots != NULL ? linkMask + 1 : 0, num));
+    printErr(" slots\n");
+}
+
+/**
+ * This function sorts the offsets by their keys with the LSD radix sort (one byte per pass).
+ * The histograms of every byte are counted in a single pass, and the passes where every key has the same byte are skipped.
+ *
+ * @param keys the keys of the offsets
+ * @param offsets the offsets
+ * @param tempKeys the temporary array for the keys (the same size)
+ * @param tempOffsets the temporary array for the offsets (the same size)
+ * @param n the number of the offsets
+ */
+void radixSort(unsigned long *keys, unsigned int *offsets, unsigned long *tempKeys, unsigned int *tempOffsets, long n) {
+    long counts[8][RADIX_BUCKETS];
+    unsigned long *srcKeys = keys, *dstKeys = tempKeys;
+    unsigned int *srcOffsets = offsets, *dstOffsets = tempOffsets;
+
+    if (n < 2) {
+        return;
+    }
+
+    clearMemory(counts, sizeof(counts));
+
+    for (long i = 0; i < n; i++) {
+        for (int pass = 0; pass < 8; pass++) {
+            counts[pass][(keys[i] >> (8 * pass)) & 255] += 1;
+        }
+    }
+
+    for (int pass = 0; pass < 8; pass++) {
+        long *count = counts[pass];
+        long offset = 0;
+
+        if (count[(keys[0] >> (8 * pass)) & 255] == n) { //every key has the same byte
+            continue;
+        }
+
+        for (int b = 0; b < RADIX_BUCKETS; b++) { //the counts become the first positions of the buckets
+            long c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (long i = 0; i < n; i++) {
+            long pos = count[(srcKeys[i] >> (8 * pass)) & 255]++;
+            dstKeys[pos] = srcKeys[i];
+            dstOffsets[pos] = srcOffsets[i];
+        }
+
+        unsigned long *swapKeys = srcKeys;
+        unsigned int *swapOffsets = srcOffsets;
+        srcKeys = dstKeys;
+        srcOffsets = dstOffsets;
+        dstKeys = swapKeys;
+        dstOffsets = swapOffsets;
+    }
+
+    if (srcKeys != keys) { //an odd number of passes, so the result is in the temporary arrays
+        for (long i = 0; i < n; i++) {
+            keys[i] = srcKeys[i];
+            offsets[i] = srcOffsets[i];
+        }
+    }
+}
+
+/**
+ * This function reads the whole directory into the given getdents64 buffer (the buffer doubles when it is full),
+ * and sorts the entries by their inode numbers (the -I option), so that the files are opened in the order of the inode table.
+ * On ext4 and XFS, the inode table is read ahead (i.e. inode_readahead_blks), so on a cold cache the following inodes
+ * are already read when they are opened, instead of seeking to a random block of the inode table for each file.
+ *
+ * @param fd the file descriptor of the directory
+ * @param buf the pointer to the getdents64 buffer
+ * @param bufSize the pointer to the size of the buffer
+ * @param o the order of the entries
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int loadByInode(long fd, char **buf, long *bufSize, struct inodeOrder *o) {
+    long used = 0, calls = 0, records = 0, count = 0;
+
+    if (reserveDirentBuffer(buf, bufSize, fd) < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        if (*bufSize - used < MAX_DIRENT_RECORD) { //the next record might not fit, so double the buffer
+            char *grown = (char *) mysbrk(*bufSize * 2);
+
+            if (grown == NULL) {
+                printErr("mycp: out of memory\n");
+                return -1;
+            }
+
+            for (long i = 0; i < used; i++) {
+                grown[i] = (*buf)[i];
+            }
+            *buf = grown;
+            *bufSize *= 2;
+        }
+
+        long nread = getDents(fd, *buf + used, *bufSize - used);
+        calls += 1;
+
+        if (nread < 0) {
+            printErr("Error occurred in the getdents64 syscall\n");
+            break;
+        } else if (nread == 0) { //check if the getdents64 syscall is on the end of the directory
+            break;
+        }
+        used += nread;
+    }
+
+    for (long bpos = 0; bpos < used; records++) {
+        bpos += ((struct linux_dirent64 *)(*buf + bpos))->d_reclen;
+    }
+    countDirents(calls, records);
+
+    if (records > o->capacity) {
+        long capacity = (records > o->capacity * 2) ? records : o->capacity * 2;
+        unsigned int *offsets = (unsigned int *) mysbrk(capacity * sizeof(unsigned int));
+        unsigned int *tempOffsets = (unsigned int *) mysbrk(capacity * sizeof(unsigned int));
+        unsigned long *keys = (unsigned long *) mysbrk(capacity * sizeof(unsigned long));
+        unsigned long *tempKeys = (unsigned long *) mysbrk(capacity * sizeof(unsigned long));
+
+        if (offsets == NULL || tempOffsets == NULL || keys == NULL || tempKeys == NULL) {
+            printErr("mycp: out of memory\n");
+            return -1;
+        }
+
+        o->offsets = offsets;
+        o->tempOffsets = tempOffsets;
+        o->keys = keys;
+        o->tempKeys = tempKeys;
+        o->capacity = capacity;
+    }
+
+    for (long bpos = 0; bpos < used;) {
+        struct linux_dirent64 *ld = (struct linux_dirent64 *)(*buf + bpos);
+
+        if (strCompare(ld->d_name, ".") != 0 && strCompare(ld->d_name, "..") != 0) {
+            o->offsets[count] = (unsigned int) bpos;
+            o->keys[count] = ld->d_ino;
+            count += 1;
+        }
+        bpos += ld->d_reclen;
+    }
+
+    radixSort(o->keys, o->offsets, o->tempKeys, o->tempOffsets, count);
+    o->count = count;
+    o->next = 0;
+
+    return 0;
 }
 
 /**
- * Prints out the given text via stderr stream.
+ * This function returns the next entry of the directory in the inode order.
  *
- * @param text the error message
- * @return If the write syscall success, returns 1. Otherwise, returns -1.
+ * @param o the order of the entries
+ * @param buf the getdents64 buffer that has the whole directory
+ * @return the next entry, or NULL at the end of the directory
  */
-int printErr(const char *text) {
-    long l = 2; //2 for stderr
-    return writeText(text, l);
+struct linux_dirent64 *nextByInode(struct inodeOrder *o, char *buf) {
+    if (o->next >= o->count) {
+        return NULL;
+    }
+
+    return (struct linux_dirent64 *)(buf + o->offsets[o->next++]);
 }
 
 /**
- * This function is a wrapper function of open system call.
+ * This function prepares the given level of the directory walk for the given directory.
+ * With the -I option, the whole directory is read and sorted by the inode numbers here.
  *
- * @param name the name of the directory that should be opened
- * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. Otherwise, returns some negative value.
+ * @param level the level of the walk
+ * @param dir the opened directory
+ * @return On success, returns 0. Otherwise, returns -1.
  */
-int openFile(char *name) {
-    long ret = -1;
-    int flag = O_RDONLY;
-    int mode = OPEN_MODE;
+int startLevel(struct walkLevel *level, struct dirNode *dir) {
+    level->dir = dir;
+    level->nread = 0;
+    level->bpos = 0;
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = name
-        "movq %3, %%rsi\n\t" // %3 = flag
-        "movq %4, %%rdx\n\t" // %4 = mode
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) OPEN_SYSCALL), "r"(name), "r"((long)flag), "r"((long)mode)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+    if (inodeOrder) {
+        return loadByInode(dir->srcFd, &level->buf, &level->bufSize, &level->byInode);
+    }
 
-    return ret;
+    return reserveDirentBuffer(&level->buf, &level->bufSize, dir->srcFd);
 }
 
 /**
- * This is a wrapper function of the close syscall.
+ * This function finds the file type of the given directory entry.
+ * Some file systems do not fill the d_type, so the file stat is checked relative to the directory in that case.
  *
- * @param fd the file descriptor of the opened file (or directory)
- * @return Returns zero on success. On error, negative value would be returned, which will depend on the setted error number.
+ * @param dir the directory that contains the entry
+ * @param ld the directory entry
+ * @return the file type (i.e. DT_DIR, DT_REG)
  */
-int closeFile(long fd) {
-    long ret = -1;
+char direntType(struct dirNode *dir, struct linux_dirent64 *ld) {
+    char d_type = ld->d_type;
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fd
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) CLOSE_SYSCALL), "r"(fd)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+    if (d_type == DT_UNKNOWN) {
+        struct stat stats;
 
-    return ret;
+        if (checkFileStatAt(dir->srcFd, ld->d_name, &stats, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(stats.st_mode)) {
+            d_type = DT_DIR;
+        }
+    }
+
+    return d_type;
 }
 
 /**
- * This function is a wrapper function of the read system call.
- * It reads the data from the file that is corresponding to the given file descriptor.
+ * This function grows the stack of the directory walk to the given capacity.
+ * The getdents buffers of the levels are kept, so they are reused by the following directories.
  *
- * @param fd the file descriptor
- * @param buf the buffer to store the read data
- * @param count the total number of bits to read
- * @return Returns the number of bytes that were read. If value is negative, then the system call returned an error.
+ * @param levels the current stack (or NULL)
+ * @param count the number of levels in the current stack
+ * @param capacity the new capacity
+ * @return the new stack, or NULL if the heap is full
  */
-int readFile(unsigned int fd, char *buf, long count) {
-    long ret = -1;
+struct walkLevel *growWalkStack(struct walkLevel *levels, int count, int capacity) {
+    struct walkLevel *grown = (struct walkLevel *) mysbrk(capacity * sizeof(struct walkLevel));
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) READ_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = (long) fd
-        "movq %3, %%rsi\n\t" // %3 = buf
-        "movq %4, %%rdx\n\t" // %4 = count
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) READ_SYSCALL), "r"((long) fd), "r"(buf), "r"(count) //convert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+    if (grown == NULL) {
+        return NULL;
+    }
 
-    return ret;
+    for (int i = 0; i < capacity; i++) {
+        if (i < count) {
+            grown[i] = levels[i];
+        } else {
+            grown[i].buf = NULL;
+            grown[i].bufSize = 0;
+            clearMemory(&grown[i].byInode, sizeof(struct inodeOrder));
+        }
+    }
+
+    return grown;
 }
 
 /**
- * This function is a wrapper function of the unlink syscall.
- * This function removes the file from the file system.
+ * This function walks the source directory with the getdents system call.
+ * It checks all files and sub-directories in the target directory.
+ * Instead of the recursion, the walk keeps an explicit stack of the opened directories, and every
+ * file (and sub-directory) is opened relative to the file descriptors of the directory at the top of the stack.
  *
- * @param name the file path name of the target file.
- * @return On success, 0 is returned. On error, some negative value will be returned.
+ * @param directoryName the name of the target directory.
+ * @param destinationName the name of the destination directory.
  */
-int removeFile(char *name) {
-    long ret = -1;
+void getDirectoryEntries(char *directoryName, char *destinationName) {
+    struct dirNode *root = newDirNode(NULL, directoryName);
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) UNLINK_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = name
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) UNLINK_SYSCALL), "r"(name)
-        : "%rax", "%rdi", "memory"
-    );
+    if (root == NULL) {
+        return;
+    }
+    root->destName = destinationName;
 
-    return ret;
-}
+    int capacity = MIN_WALK_DEPTH;
+    struct walkLevel *levels = growWalkStack(NULL, 0, capacity);
 
-/**
- * This is a wrapper function of the access syscall.
- *
- * @param fileName the name of the file to check if it exists
- * @return If the file exists, returns 0. Otherwise, returns some negative integer
- */
-int accessToFile(char *fileName) {
-    long ret = -1;
+    if (levels == NULL || openDirNode(root) < 0 || startLevel(&levels[0], root) < 0) {
+        releaseDirNode(root);
+        return;
+    }
 
-    asm("movq %1, %%rax\n\t"
-        "movq %2, %%rdi\n\t"
-        "movq %3, %%rsi\n\t"
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) ACCESS_SYSCALL), "r"(fileName), "r"((long)R_OK)
-        : "%rax", "%rdi", "%rsi", "memory");
+    int depth = 1;
 
-    return ret;
-}
+    while (depth > 0) {
+        struct walkLevel *level = &levels[depth - 1];
+        struct linux_dirent64 *ld;
 
-/**
- * This is a wrapper function of the exit syscall.
- *
- * @param exitCode the exit code
- */
-void exitProcess(int exitCode) {
-    long l = -1;
+        if (inodeOrder) {
+            if ((ld = nextByInode(&level->byInode, level->buf)) == NULL) { //the end of the directory, so go back to the parent directory
+                releaseDirNode(level->dir);
+                depth -= 1;
+                continue;
+            }
+        } else if (level->bpos >= level->nread) { //every entry in the buffer is checked, so read the next entries
+            /* 
+             * If the system call success, the getdents64 syscall returns the number of bytes read. 
+             * On end of directory, the getdents64 syscall returns 0. 
+             * Otherwise, it returns -errno.
+             */
+            level->nread = getDents(level->dir->srcFd, level->buf, level->bufSize);
+            level->bpos = 0;
+            countDirents(1, 0);
+
+            if (level->nread <= 0) { //the end of the directory, so go back to the parent directory
+                if (level->nread < 0) {
+                    printErr("Error occurred in the getdents64 syscall\n");
+                }
+                releaseDirNode(level->dir);
+                depth -= 1;
+            }
+            continue;
+        } else {
+            ld = (struct linux_dirent64 *)(level->buf + level->bpos);
+            level->bpos += ld->d_reclen;
+            countDirents(0, 1);
+        }
 
-    asm("movq %1, %%rax\n\t"
-        "movq %2, %%rdi\n\t"
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(l)
-        : "r"((long) EXIT_SYSCALL), "r"((long) exitCode)
-        : "%rax", "%rdi"
-    );
-}
+        if (strCompare(ld->d_name, ".") == 0 || strCompare(ld->d_name, "..") == 0) {
+            continue;
+        }
 
-/**
- * This is a wrapper function of the truncate syscall.
- * This function causes the regular file named by path to be truncated to a size of precisely length bytes.
- *
- * @param filePath the file path of the target file
- * @param length the size to truncate
- * @return On success, zero is returned. On error, some negative value, which depends to the error number, will be returned.
- */
-int truncateFile(char *filePath, long length) {
-    long ret = -1;
+        if (direntType(level->dir, ld) != DT_DIR) {
+            if (copyMode == MODE_URING) {
+                //in the io_uring mode, the file is queued and copied while the directory walk goes on.
+                uringQueueFile(level->dir, ld->d_name);
+            } else {
+                //if the current file is not a directory, call the copyFile() to copy this file to the destination.
+                copyFile(level->dir, ld->d_name, &copyBuffer);
+            }
+            continue;
+        }
 
-    asm("movq %1, %%rax\n\t" //%1 == (long) TRUNC_SYSCALL
-        "movq %2, %%rdi\n\t" //%2 == filePath
-        "movq %3, %%rsi\n\t" //%3 == length
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" //%0 == ret
-        : "=r"(ret)
-        : "r"((long) TRUNC_SYSCALL), "r"(filePath), "r"(length)
-        : "%rax", "%rdi", "%rsi", "memory"
-    );
+        //if the current file is a directory, make a new directory, and push it to the stack of the walk.
+        makeDirectoryAt(level->dir->dstFd, ld->d_name);
 
-    return ret;
-}
+        struct dirNode *child = newDirNode(level->dir, ld->d_name);
 
-/**
- * This is a wrapper function of the ftruncate syscall.
- * This function causes the regular file named by the file descriptor to be truncated to a size of precisely length bytes.
- *
- * @param fd the file descriptor of the target file
- * @param length the size to truncate
- * @return On success, zero is returned. On error, some negative value, which depends to the error number, will be returned.
- */
-int ftruncateFile(int fd, long length) {
-    long ret = -1;
+        if (child == NULL) {
+            continue;
+        }
 
-    asm("movq %1, %%rax\n\t" //%1 == (long) TRUNC_SYSCALL
-        "movq %2, %%rdi\n\t" //%2 == (long) fd
-        "movq %3, %%rsi\n\t" //%3 == length
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" //%0 == ret
-        : "=r"(ret)
-        : "r"((long) FTRUNC_SYSCALL), "r"((long) fd), "r"(length)
-        : "%rax", "%rdi", "%rsi", "memory");
+        if (depth == capacity) {
+            struct walkLevel *grown = growWalkStack(levels, depth, capacity * 2);
 
-    return ret;
+            if (grown == NULL) {
+                releaseDirNode(child);
+                continue;
+            }
+            levels = grown;
+            capacity *= 2;
+        }
+
+        if (openDirNode(child) < 0 || startLevel(&levels[depth], child) < 0) {
+            releaseDirNode(child);
+            continue;
+        }
+
+        depth += 1;
+    }
 }
 
 /**
- * This is a wrapper function of the creat syscall.
- * It creates the file with a given path name.
+ * This function puts the finished task to the free list, so that it is reused by the next task.
  *
- * @param pathName the path name of the file that would be created
- * @return Returns the new file descriptor on success. Otherwise, some negative integer will be returned.
+ * @param task the finished task
  */
-int createFile(char *pathName) {
-    long ret = -1;
-
-    asm("movq %1, %%rax\n\t"
-        "movq %2, %%rdi\n\t"
-        "movq %3, %%rsi\n\t"
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) CREAT_SYSCALL), "r"(pathName), "r"((long) CREATE_MODE)
-        : "%rax", "%rdi", "%rsi", "memory"
-    );
-
-    return ret;
+void recycleTask(struct copyTask *task) {
+    spinLock(&freeTaskLock);
+    task->next = freeTasks;
+    freeTasks = task;
+    spinUnlock(&freeTaskLock);
 }
 
 /**
- * This is a wrapper function for the mkdir system call.
- * It creates a new directory with a given name.
+ * This function pushes a new task to the bottom of the deque of the given worker, and wakes an idle worker.
+ * The task takes over a reference of the given directory, which is released when the task is done.
  *
- * @param name the name of the new directory
- * @return On success, 0 will be returned. Otherwise, some negative value will be returned.
+ * @param w the worker that owns the deque
+ * @param type TASK_FILE or TASK_DIR
+ * @param dir the directory that contains the file (or the directory to scan)
+ * @param name the name of the file in that directory (NULL for the directory task)
  */
-int makeDirectory(char *name) {
-    long ret = -1;
+void pushTask(struct worker *w, char type, struct dirNode *dir, char *name) {
+    spinLock(&freeTaskLock);
+    struct copyTask *task = freeTasks;
+    if (task != NULL) {
+        freeTasks = task->next;
+    }
+    spinUnlock(&freeTaskLock);
 
-    asm("movq %1, %%rax\n\t" //%1 == (long) MKDIR_SYSCALL
-        "movq %2, %%rdi\n\t" //%2 == name
-        "movq %3, %%rsi\n\t" //%3 == (long) MKDIR_MODE
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" //%0 == ret
-        : "=r"(ret)
-        : "r"((long) MKDIR_SYSCALL), "r"(name), "r"((long)MKDIR_MODE)
-        : "%rax", "%rdi", "%rsi", "memory");
+    if (task == NULL && (task = (struct copyTask *) mysbrk(sizeof(struct copyTask))) == NULL) {
+        printErr("mycp: out of memory\n");
+        releaseDirNode(dir);
+        return;
+    }
 
-    return ret;
+    task->type = type;
+    task->dir = dir;
+    task->name = keepName(task->nameBuf, name);
+    task->next = NULL;
+
+    __atomic_add_fetch(&outstandingTasks, 1, __ATOMIC_SEQ_CST);
+
+    spinLock(&w->lock);
+    task->prev = w->bottom;
+    if (w->bottom != NULL) {
+        w->bottom->next = task;
+    } else {
+        w->top = task;
+    }
+    w->bottom = task;
+    __atomic_add_fetch(&w->count, 1, __ATOMIC_SEQ_CST);
+    spinUnlock(&w->lock);
+
+    __atomic_add_fetch(&workEpoch, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&idleWorkers, __ATOMIC_SEQ_CST) > 0) {
+        futexCall((int *) &workEpoch, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
 }
 
 /**
- * This function is a wrapper function of the rmdir system call.
- * It removes the particular directory.
+ * This function takes a task from the deque of the given worker.
+ * The owner pops the newest task (depth first, so the directories are finished quickly),
+ * and the thieves steal the oldest task (the biggest unexplored subtrees).
  *
- * @param name the name of the target directory.
- * @return On success, 0 will be returned. Otherwise, some negative value will be returned.
+ * @param w the worker that owns the deque
+ * @param steal if non-zero, takes the oldest task. Otherwise, takes the newest task.
+ * @return the task, or NULL if the deque is empty
  */
-int removeDirectory(char *name) {
-    long ret = -1;
+struct copyTask *takeTask(struct worker *w, char steal) {
+    if (__atomic_load_n(&w->count, __ATOMIC_SEQ_CST) == 0) {
+        return NULL;
+    }
 
-    asm("movq %1, %%rax\n\t" //%1 == (long) RMDIR_SYSCALL
-        "movq %2, %%rdi\n\t" //%2 == name
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" //%0 == ret
-        : "=r"(ret)
-        : "r"((long) RMDIR_SYSCALL), "r"(name)
-        : "%rax", "%rdi", "memory");
+    spinLock(&w->lock);
+    struct copyTask *task = steal ? w->top : w->bottom;
 
-    return ret;
+    if (task != NULL) {
+        if (steal) {
+            w->top = task->next;
+            if (w->top != NULL) {
+                w->top->prev = NULL;
+            } else {
+                w->bottom = NULL;
+            }
+        } else {
+            w->bottom = task->prev;
+            if (w->bottom != NULL) {
+                w->bottom->next = NULL;
+            } else {
+                w->top = NULL;
+            }
+        }
+        __atomic_sub_fetch(&w->count, 1, __ATOMIC_SEQ_CST);
+    }
+    spinUnlock(&w->lock);
+
+    return task;
 }
 
 /**
- * This is a wrapper function of the chown syscall.
- * The aim of this function is to change the owner of the file with the given user id and group id.
+ * This function finds the next task for the given worker.
+ * It pops its own deque first, and then tries to steal from the other workers, starting from its neighbour.
  *
- * @param name the name of the target file
- * @param uid the new user id
- * @param gid the new group id
- * @return On success, zero is returned.
- *         On error, some negative value would be returned, which depends on the error number of that error.
+ * @param self the worker that looks for a task
+ * @return the task, or NULL if every deque is empty
  */
-int my_chown(char *name, long uid, long gid) {
-    long ret = -1;
+struct copyTask *findTask(struct worker *self) {
+    struct copyTask *task = takeTask(self, 0);
 
-    asm("movq %1, %%rax\n\t" //%1 == (long) CHOWN_SYSCALL
-        "movq %2, %%rdi\n\t" //%2 == name
-        "movq %3, %%rsi\n\t" //%3 == uid
-        "movq %4, %%rdx\n\t" //%4 == gid
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" //%0 == ret
-        : "=r"(ret)
-        : "r"((long)CHOWN_SYSCALL), "r"(name), "r"(uid), "r"(gid)
-        : "%rax", "%rdi", "%rsi", "rdx", "memory"
-    );
+    for (int i = 1; task == NULL && i < workerCount; i++) {
+        task = takeTask(&workers[(self->index + i) % workerCount], 1);
+    }
 
-    return ret;
+    return task;
 }
 
 /**
- * This function removes the generated directory(if required), and exit the process.
+ * This function queues (or copies) the given entry of the scanned directory.
+ * The sub-directories are created before their tasks are pushed, so every directory exists
+ * before any file is copied into it. While MAX_QUEUED_TASKS tasks are queued, the files are copied
+ * by the scanner itself, so the memory for the tasks stays flat even for the huge directories.
  *
- * @param generated to check whether the process should remove the directory or not
- * @param name the name of the target directory
+ * @param self the worker that runs the scan
+ * @param dir the scanned directory
+ * @param ld the directory entry (not "." or "..")
  */
-void terminateAndRemoveDir(char generated, char *name) {
-    if (generated) {
-        removeDirectory(name);
+void scanEntry(struct worker *self, struct dirNode *dir, struct linux_dirent64 *ld) {
+    char d_type = direntType(dir, ld);
+
+    if (d_type != DT_DIR && __atomic_load_n(&outstandingTasks, __ATOMIC_RELAXED) >= MAX_QUEUED_TASKS) {
+        //the other workers have enough tasks, so the file is copied without queueing it (the queue stays bounded)
+        copyFile(dir, ld->d_name, &self->buffer);
+    } else if (d_type != DT_DIR) {
+        retainDirNode(dir);
+        pushTask(self, TASK_FILE, dir, ld->d_name);
+    } else {
+        makeDirectoryAt(dir->dstFd, ld->d_name); //the directory must exist before its children are copied
+
+        struct dirNode *child = newDirNode(dir, ld->d_name);
+
+        if (child != NULL) {
+            pushTask(self, TASK_DIR, child, NULL);
+        }
     }
-    myUnMap();
-    exitProcess(0);
 }
 
 /**
- * This function copies the target file to the file, which is corresponding to the given file descriptor.
+ * This function opens and scans the given directory, and each entry is queued with the scanEntry().
+ * The sub-directories are opened by the workers that run their tasks. With the -I option,
+ * the whole directory is read first, and the entries are queued in the order of their inode numbers.
  *
- * @param name the name of the target file.
- * @param destName the path name of the destination file.
- * @param destDir the name of the destination directory.
+ * @param self the worker that runs the task
+ * @param dir the directory to scan
  */
-void copyFile(char *name, char *destName, char *destDir) {
-    struct stat stats; // declares struct stat to store stat of argument
-    int stat = checkFileStat(name, &stats);
+void scanDirectoryTask(struct worker *self, struct dirNode *dir) {
+    long calls = 0, entries = 0;
 
-    if (stat != 0) { //if the stat syscall fails, some negative value will be returned
-        writeText("mycp: cannot access '", 1);
-        writeText(name, 1);
-        writeText("' : No such file or directory\n", 1);
+    if (openDirNode(dir) < 0) {
         return;
     }
 
-    int fd;
+    if (inodeOrder) {
+        struct linux_dirent64 *ld;
+
+        if (loadByInode(dir->srcFd, &self->direntBuf, &self->direntSize, &self->byInode) < 0) {
+            return;
+        }
+
+        while ((ld = nextByInode(&self->byInode, self->direntBuf)) != NULL) {
+            scanEntry(self, dir, ld);
+        }
+        return;
+    }
 
-    //if the createFile function returns negative value, it means that the creat syscall failed
-    if ((fd = createFile(destName)) < 0) {
-        terminateAndRemoveDir(1, destDir);
+    if (reserveDirentBuffer(&self->direntBuf, &self->direntSize, dir->srcFd) < 0) {
+        return;
     }
 
-    int readFd = openFile(name);
+    for (;;) {
+        long nread = getDents(dir->srcFd, self->direntBuf, self->direntSize);
+        calls += 1;
 
-    if (fd < 0) {
-        //Print out the error message
-        writeText("mycp: cannot access '", 1);
-        writeText(destName, 1);
-        writeText("' : Permission denied\n", 1);
+        if (nread < 0) {
+            printErr("Error occurred in the getdents64 syscall\n");
+            break;
+        } else if (nread == 0) { //check if the getdents64 syscall is on the end of the directory
+            break;
+        }
 
-        removeFile(destName); //use the wrapper function of the unlink syscall to remove the file.
-        terminateAndRemoveDir(1, destDir);
-    } else if (readFd < 0) {
-        //Print out the error message
-        writeText("mycp: cannot access '", 1);
-        writeText(name, 1);
-        writeText("' : Permission denied\n", 1);
+        for (long bpos = 0; bpos < nread;) {
+            struct linux_dirent64 *ld = (struct linux_dirent64 *)(self->direntBuf + bpos);
+            entries += 1;
 
-        removeFile(destName); //use the wrapper function of the unlink syscall to remove the file.
-        terminateAndRemoveDir(1, destDir);
-    }
+            if ((strCompare(ld->d_name, ".") != 0) && strCompare(ld->d_name, "..")) {
+                scanEntry(self, dir, ld);
+            }
 
-    if (S_ISDIR(stats.st_mode)) { //when the given file is a directory
-        writeText("mycp: ", 1);
-        writeText(name, 1);
-        writeText(": Is a directory\n", 1);
-        return;
+            bpos += ld->d_reclen;
+        }
     }
 
-    char buffer[READ_SIZE + 1];
-    int length;
+    countDirents(calls, entries);
+}
 
-    //Reads maximum 4096 bytes at once.
-    while ((length = readFile(readFd, buffer, READ_SIZE)) > 0) {
-        buffer[length] = '\0';
-        writeText(buffer, fd);
-    }
+/**
+ * This function is the main loop of each worker of the parallel copy.
+ * The worker runs the tasks until every deque is empty and no task is running, and
+ * sleeps on the workEpoch futex while there is no task to steal.
+ *
+ * @param arg the worker
+ * @return always 0
+ */
+int workerMain(void *arg) {
+    struct worker *self = (struct worker *) arg;
 
-    struct stat newStat;
-    checkFileStat(destName, &newStat);
+    for (;;) {
+        struct copyTask *task = findTask(self);
 
-    /* 
-     * If the size of the original file and new file are different,
-     * truncate the new file with the original file's length
-     */
-    if (newStat.st_size != stats.st_size) {
-        int truncVal = truncateFile(destName, stats.st_size);
+        if (task == NULL) {
+            __atomic_add_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+            unsigned seen = __atomic_load_n(&workEpoch, __ATOMIC_SEQ_CST);
+
+            task = findTask(self);
+
+            if (task == NULL && __atomic_load_n(&outstandingTasks, __ATOMIC_SEQ_CST) > 0) {
+                struct timespec timeout = { 0, IDLE_WAIT_NS };
+                futexCall((int *) &workEpoch, FUTEX_WAIT_PRIVATE, seen, &timeout);
+            }
+            __atomic_sub_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
 
-        if (truncVal < 0) { //if the trunc fails, try again with the ftrunc syscall.
-            ftruncateFile(fd, stats.st_size);
+            if (task == NULL) {
+                if (__atomic_load_n(&outstandingTasks, __ATOMIC_SEQ_CST) == 0) {
+                    break;
+                }
+                continue;
+            }
         }
-    }
 
-    //change the file permission of the new file with the file permission mode of the original file.
-    my_chmod(destName, stats.st_mode);
+        if (task->type == TASK_DIR) {
+            scanDirectoryTask(self, task->dir);
+        } else {
+            copyFile(task->dir, task->name, &self->buffer);
+        }
+        releaseDirNode(task->dir);
+        recycleTask(task);
 
-    //change the user id and group id of the new file with the uid and gid of the original file.
-    my_chown(destName, stats.st_uid, stats.st_gid);
+        if (__atomic_sub_fetch(&outstandingTasks, 1, __ATOMIC_SEQ_CST) == 0) {
+            __atomic_add_fetch(&workEpoch, 1, __ATOMIC_SEQ_CST);
+            futexCall((int *) &workEpoch, FUTEX_WAKE_PRIVATE, MAX_WORKERS, NULL); //every task is done
+        }
+    }
 
-    //close the opened files
-    closeFile(readFd);
-    closeFile(fd);
+    return 0;
 }
 
 /**
- * This function is a wrapper function of the getdents system call.
- * It checks all files and sub-directories in the target directory.
- * If there is any sub-directory in the target directory, this function 
- * calls itself recursively for the recursive copy.
+ * This function copies the source directory with the given number of workers.
+ * The main thread works as the first worker, and the other workers are created with the clone syscall.
+ * If a worker thread could not be created, the copy goes on with the workers that were created.
+ * Everything that the parallel copy allocated from the custom heap is released when it finishes.
  *
- * @param directoryName the name of the target directory.
+ * @param directoryName the name of the source directory.
  * @param destinationName the name of the destination directory.
  */
-void getDirectoryEntries(char *directoryName, char *destinationName) {
-    long nread = -1;
-    int bpos;
-    char d_type, buf[GETDENTS_SIZE];
-    struct linux_dirent *ld;
-    long fd = openFile(directoryName);
-
-    for (;;) { //use the endless loop, which will loop until the getdents syscall reads all files in the directory.
-        /* 
-         * If the system call success, the getdents syscall returns the number of bytes read. 
-         * On end of directory, the getdents syscall returns 0. 
-         * Otherwise, it returns -1.
-         */
-        asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-            "movq %2, %%rdi\n\t" // %2 = fd
-            "movq %3, %%rsi\n\t" // %3 = buf
-            "movq %4, %%rdx\n\t" // %4 = (long) GETDENT_BUFFER_SIZE
-            "syscall\n\t"
-            "movq %%rax, %0\n\t"
-            : "=r"(nread)
-            : "r"((long)GETDENTS_SYSCALL), "r"(fd), "r"(buf), "r"((unsigned long)GETDENTS_SIZE)
-            : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-        if (nread == -1) {
-            char errorMsg[40] = "Error occurred in the getdents syscall\n";
-            printErr(errorMsg); //print out the error message
-            break;
-        } else if (nread == 0) { //check if the getdents syscall is on the end of the directory
-            break;
-        }
+void copyDirectoryParallel(char *directoryName, char *destinationName) {
+    struct arenaMark mark = markArena(&heap);
 
-        for (bpos = 0; bpos < nread;) {
-            ld = (struct linux_dirent *)(buf + bpos);
+    workers = (struct worker *) mysbrk(workerCount * sizeof(struct worker));
+    long stacks = mapMemory((long) workerCount * WORKER_STACK_SIZE);
 
-            if ((strCompare(ld->d_name, ".") != 0) && strCompare(ld->d_name, "..")) {
-                //create new string, which will be the path name of the copied file.
-                char *tempName = strconcat(destinationName, "/");
-                char *newFileName = strconcat(tempName, ld->d_name);
+    if (workers == NULL || stacks < 0) {
+        if (stacks >= 0) {
+            unmapMemory((char *) stacks, (long) workerCount * WORKER_STACK_SIZE);
+        }
+        resetArena(&heap, mark);
+        workerCount = 1;
+        getDirectoryEntries(directoryName, destinationName);
+        return;
+    }
 
-                //create new string, which is the path name of the current file.
-                char *tempPath = strconcat(directoryName, "/");
-                char *path = strconcat(tempPath, ld->d_name);
+    for (int i = 0; i < workerCount; i++) {
+        clearMemory(&workers[i], sizeof(struct worker));
+        workers[i].index = i;
+    }
 
-                /* The d_type is a byte at the end of the structure that indicates the file type. */
-                d_type = *(buf + bpos + ld->d_reclen - 1);
+    struct dirNode *root = newDirNode(NULL, directoryName);
 
-                if (d_type != DT_DIR) {
-                    //if the current file is not a directory, call the copyFile() to copy this file to the destination.
-                    copyFile(path, newFileName, destinationName);
-                } else {
-                    //if the current file is a directory, make a new directory.
-                    makeDirectory(newFileName);
+    if (root != NULL) { //if the source directory could not be opened, there is nothing to copy, but the workers are still released
+        root->destName = destinationName;
+        pushTask(&workers[0], TASK_DIR, root, NULL);
 
-                    //then call the getDirectoryEntries() itself recursively for the recursive copy.
-                    getDirectoryEntries(path, newFileName);
-                }
+        int spawned = 1;
+        for (int i = 1; i < workerCount; i++) {
+            char *stackTop = (char *) stacks + (long) (i + 1) * WORKER_STACK_SIZE;
+
+            if (spawnThread(workerMain, &workers[i], stackTop, &workers[i].tid) < 0) {
+                break;
             }
+            spawned += 1;
+        }
 
-            bpos += ld->d_reclen;
+        workerMain(&workers[0]);
+
+        for (int i = 1; i < spawned; i++) {
+            joinThread(&workers[i].tid);
+        }
+    }
+
+    for (int i = 0; i < workerCount; i++) {
+        if (workers[i].buffer.data != NULL) {
+            unmapMemory(workers[i].buffer.data, workers[i].buffer.size);
         }
     }
+    unmapMemory((char *) stacks, (long) workerCount * WORKER_STACK_SIZE);
+
+    /* every worker has exited, so the workers, the tasks and the directories are released in bulk */
+    resetArena(&heap, mark);
+    freeNodes = NULL;
+    freeTasks = NULL;
 }
 
 /**
@@ -767,20 +3220,160 @@ char checkIfCopyingIntoItself(char *path1, char *path2) {
     return isPrefix;
 }
 
+/**
+ * This function parses the command line options, and collects the operands (the source and the destination).
+ *
+ *   -m MODE   the copy mode: "auto" (default), "clone", "range", "rw" or "uring"
+ *   -q DEPTH  the number of SQEs that the io_uring copy engine keeps in flight (default 32)
+ *   -j N      copies the directory with N workers (default 1)
+ *   -s        copies only the data extents of the sparse files
+ *   -z        turns the zero blocks into holes as well (implies -s)
+ *   -I        opens the entries of each directory in the order of their inode numbers
+ *   -i        skips the files whose destination has the same size and modified time (and copies the modified times)
+ *   -d        rewrites only the changed blocks of the existing destination files (implies -i)
+ *   -V MODE   reads each copied file again ("cache" or "direct") and compares its CRC-32C with the copied data
+ *   -M FILE   writes the CRC-32C and the path of each copied file to the manifest
+ *   -c FILE   checks the files in the manifest instead of copying (without the operands)
+ *   -H        recreates the hardlinks of the source files in the destination, instead of copying each link
+ *   -T        prints out the current and the peak usage of the custom heap, and the number of the getdents64 syscalls
+ *
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @param operands the array to store the first 2 operands
+ * @return the number of operands, or -1 if there is an invalid option
+ */
+int parseOptions(int argc, char **argv, char **operands) {
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+
+        if (arg[0] != '-' || arg[1] == '\0') { //an operand
+            if (count < 2) {
+                operands[count] = arg;
+            }
+            count += 1;
+            continue;
+        }
+
+        if (arg[2] != '\0') {
+            return -1;
+        }
+
+        if (arg[1] == 's') {
+            sparseMode = 1;
+            continue;
+        } else if (arg[1] == 'T') {
+            showStats = 1;
+            continue;
+        } else if (arg[1] == 'I') {
+            inodeOrder = 1;
+            continue;
+        } else if (arg[1] == 'i') {
+            incremental = 1;
+            continue;
+        } else if (arg[1] == 'H') {
+            hardlinkMode = 1;
+            continue;
+        } else if (arg[1] == 'd') {
+            incremental = 1; //the block delta only runs on the destination files that the incremental mode found changed
+            deltaMode = 1;
+            continue;
+        } else if (arg[1] == 'z') {
+            sparseMode = 1; //the skipped zero blocks need the destination file to be sized in advance
+            zeroDetect = 1;
+            continue;
+        }
+
+        if (i + 1 >= argc) { //every other option takes a value
+            return -1;
+        }
+
+        char *value = argv[++i];
+
+        if (arg[1] == 'm') {
+            if (strCompare(value, "auto") == 0) {
+                copyMode = MODE_AUTO;
+            } else if (strCompare(value, "clone") == 0) {
+                copyMode = MODE_CLONE;
+            } else if (strCompare(value, "range") == 0) {
+                copyMode = MODE_RANGE;
+            } else if (strCompare(value, "rw") == 0) {
+                copyMode = MODE_RW;
+            } else if (strCompare(value, "uring") == 0) {
+                copyMode = MODE_URING;
+            } else {
+                return -1;
+            }
+        } else if (arg[1] == 'j') {
+            long count = parseNumber(value);
+
+            if (count < 1 || count > MAX_WORKERS) {
+                return -1;
+            }
+            workerCount = count;
+        } else if (arg[1] == 'q') {
+            long depth = parseNumber(value);
+
+            if (depth < 1 || depth > MAX_QUEUE_DEPTH) {
+                return -1;
+            }
+            queueDepth = depth;
+        } else if (arg[1] == 'V') {
+            if (strCompare(value, "cache") == 0) {
+                verifyMode = VERIFY_CACHE;
+            } else if (strCompare(value, "direct") == 0) {
+                verifyMode = VERIFY_DIRECT;
+            } else {
+                return -1;
+            }
+            checksumMode = 1;
+        } else if (arg[1] == 'M') {
+            manifestName = value;
+            checksumMode = 1;
+        } else if (arg[1] == 'c') {
+            checkName = value;
+        } else {
+            return -1;
+        }
+    }
+
+    return count;
+}
+
 /* mycp is a program that copies the source to the destination recursively. */
 int main(int argc, char **argv) {
+    char *operands[2];
+    int count = parseOptions(argc, argv, operands);
 
-    if (argc != 3){
+    if (count == 0 && checkName != NULL) { //the -c option checks the files in the manifest without copying
+        initHeap();
+        initChecksum();
 
-        char usageMsg[38] = "Usage: ./mycp \"SOURCE\" \"DESTINATION\"\n";
-        printErr(usageMsg);
+        long failed = checkManifest(checkName);
+
+        if (showStats) {
+            printVerifyStats();
+        }
+
+        myUnMap();
+        exitProcess(failed != 0);
+    }
+
+    if (count != 2 || checkName != NULL) {
+
+        printErr("Usage: ./mycp [-m auto|clone|range|rw|uring] [-q DEPTH] [-j N] [-s] [-z] [-I] [-i] [-d] [-H] [-V cache|direct] [-M FILE] [-T] \"SOURCE\" \"DESTINATION\"\n");
+        printErr("       ./mycp [-V cache|direct] [-T] -c FILE\n");
         exitProcess(0);
 
     } else {
-        if (accessToFile(argv[1]) != 0) { //use the access syscall to check if the source file exists
+        char *source = operands[0];      //the source file (or directory)
+        char *destination = operands[1]; //the destination directory
+
+        if (accessToFile(source) != 0) { //use the access syscall to check if the source file exists
 
             printErr("mycp: cannot stat ");
-            printErr(argv[1]);
+            printErr(source);
             printErr(": Cannot find such file or directory\n");
 
             exitProcess(1);
@@ -788,44 +3381,62 @@ int main(int argc, char **argv) {
         } else {
             char notExists = 1; //to check if the destination directory exists.
 
-            if (accessToFile(argv[2]) == 0) { //use the access syscall to check if the destination directory exists.
+            if (accessToFile(destination) == 0) { //use the access syscall to check if the destination directory exists.
                 notExists = 0;
-            } else {
-                struct stat stats;
-                int val = checkFileStat(argv[2], &stats);
             }
 
-            if (strCompare(argv[1], argv[2]) == 0) { //check if the source name and the destination name are same
+            if (strCompare(source, destination) == 0) { //check if the source name and the destination name are same
                 printErr("mycp: ");
-                printErr(argv[1]);
+                printErr(source);
                 printErr(" and ");
-                printErr(argv[2]);
+                printErr(destination);
                 printErr(" are the same file.\n");
                 exitProcess(0);
             }
 
             if (notExists) {
-                makeDirectory(argv[2]); //create the destination directory.
+                makeDirectory(destination); //create the destination directory.
             }
 
             struct stat fileStat;
-            checkFileStat(argv[1], &fileStat);
+            checkFileStat(source, &fileStat);
             int val = (fileStat.st_mode & S_IFDIR) ? 1 : 0;
 
             struct stat stats;
-            if (checkFileStat(argv[2], &stats) < 0) {
+            if (checkFileStat(destination, &stats) < 0) {
                 printErr("mycp failed\n");
                 exitProcess(0);
             }
 
             if ((stats.st_mode & S_IFDIR) == 0) {
                 printErr("mycp: ");
-                printErr(argv[2]);
+                printErr(destination);
                 printErr(" is not a directory: DESTINATION should be a directory!\n");
                 exitProcess(0);
             }
 
+            if (manifestName != NULL && (manifestFd = openAt(AT_FDCWD, manifestName, MANIFEST_FLAG, CREATE_MODE)) < 0) {
+                printErr("mycp: cannot create the manifest ");
+                printErr(manifestName);
+                printErr("\n");
+                exitProcess(1);
+            }
+
             initHeap();
+            initArena(&linkArena);
+            raiseFileLimit();
+
+            if (checksumMode) {
+                initChecksum();
+
+                if (copyMode == MODE_URING) { //the blocks of the io_uring engine complete out of order, but the checksum needs the data in order
+                    copyMode = MODE_RW;
+                }
+            }
+
+            if (copyMode == MODE_URING && uringInit(queueDepth) < 0) {
+                copyMode = MODE_RW; //io_uring is not available, so fall back to the read/write loop
+            }
 
             if (val > 0) { //checkFileStat returns 1 when the target file is a directory
 
@@ -834,44 +3445,83 @@ int main(int argc, char **argv) {
                  * Basically, this is because that we need to prevent copying the directory into itself, 
                  * which will make a infinity loop of copying.
                  */
-                if(strCompare(argv[1], ".") == 0) {
+                if(strCompare(source, ".") == 0) {
                     printErr("mycp: cannot copy a directory, '.', into itself\n");
 
                     if (notExists) {
                         //remove the created destination directory.
-                        removeDirectory(argv[2]);
+                        removeDirectory(destination);
                     }
 
                     exitProcess(0);
                 }
 
                 /*
-                 * Check if the argv[1] is a prefix of argv[2] to prevent copying the directory into itself.
+                 * Check if the source is a prefix of destination to prevent copying the directory into itself.
                  *
                  * i.e. mycp should not copy the directory "test" into "test/test1" 
                  */
-                if (checkIfCopyingIntoItself(argv[1], argv[2])) {
+                if (checkIfCopyingIntoItself(source, destination)) {
                     printErr("mycp: cannot copy a directory, '");
-                    printErr(argv[1]);
+                    printErr(source);
                     printErr("', into itself\n");
 
                     if (notExists) {
                         //remove the created destination directory.
-                        removeDirectory(argv[2]);
+                        removeDirectory(destination);
                     }
 
                     exitProcess(0);
                 }
 
-                getDirectoryEntries(argv[1], argv[2]);
+                if (workerCount > 1 && copyMode != MODE_URING) {
+                    copyDirectoryParallel(source, destination);
+                } else {
+                    getDirectoryEntries(source, destination);
+                }
             } else { //checkFileStat returns 1 when the target file is not a directory.
 
-                char *name = strconcat(argv[2], "/");
-                char *newName = strconcat(name, argv[1]);
-                copyFile(argv[1], newName, argv[2]);
+                /* the source is opened relative to the current working directory, and the copy is created in the destination */
+                struct dirNode *root = newDirNode(NULL, NULL);
+
+                if (root != NULL) {
+                    root->destName = destination;
+
+                    if (openDirNode(root) == 0 && copyMode == MODE_URING) {
+                        uringQueueFile(root, source);
+                    } else if (root->dstFd >= 0) {
+                        copyFile(root, source, &copyBuffer);
+                    }
+                    releaseDirNode(root);
+                }
+            }
+
+            if (copyMode == MODE_URING) {
+                uringDrain(); //wait until every queued file is copied
+                uringRelease();
+            }
+
+            if (showStats) {
+                printArenaStats("mycp heap", &heap);
+                printDirentStats();
+
+                if (incremental) {
+                    printSyncStats();
+                }
+                if (verifyMode != VERIFY_NONE) {
+                    printVerifyStats();
+                }
+                if (hardlinkMode) {
+                    printLinkStats();
+                }
+            }
+
+            if (manifestFd >= 0) {
+                closeFile(manifestFd);
             }
 
             myUnMap();
+            releaseArena(&linkArena);
         }
 
     }
@@ -5,176 +5,369 @@
 #include <fcntl.h>
 #include <time.h>
 #include <dirent.h>
+#include <limits.h>
+#include "common.h"
 
 /* System call numbers */
-#define WRITE_SYSCALL 1      //to print out the output message of the ls command
-#define OPEN_SYSCALL 2       //to open the directory
-#define CLOSE_SYSCALL 3      //to close the opened directory or file
-#define STAT_SYSCALL 4       //to get the file stat of the specific file.
-#define MMAP_SYSCALL 9       //to implement the custom malloc
-#define MUNMAP_SYSCALL 11    //to unmap the dynamically mapped memory
-#define ACCESS_SYSCALL 21    //to check if the file exists
-#define GETDENTS_SYSCALL 78  //to get the directory entries
+#define GETPID_SYSCALL 39    //to name the temporary cache file after the process
+#define RENAME_SYSCALL 82    //to replace the cache file of the directory atomically
+#define UNLINK_SYSCALL 87    //to remove the temporary cache file when it could not be written
 #define TIME_SYSCALL 201     //to get the current time
-
-/* The buffer size for the getdents syscall */
-#define GETDENT_BUFFER_SIZE 8192 //this will be used for the getdents syscall
-
-/* mode of the open syscall */
-#define OPEN_MODE (S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) //this will be used for the open syscall
-
-/* preprocessors for the custom malloc function */
-#define MAX_HEAP_SIZE 4194304 //1024 * 4096
-#define CUSTOM_PROT (PROT_READ | PROT_WRITE)
-#define MMAP_FLAG (MAP_PRIVATE | MAP_ANONYMOUS)
+#define GETDENTS64_SYSCALL 217 //to get the directory entries
+#define OPENAT_SYSCALL 257   //to open the directory, the time zone file and the cache files
+#define NEWFSTATAT_SYSCALL 262 //to get the file stat of the file relative to the opened directory (if the statx is not supported)
+#define STATX_SYSCALL 332    //to get only the required fields of the file stat, relative to the opened directory
+
+/* The buffer size for the getdents64 syscall */
+#define MIN_DIRENT_BUFFER 8192    //the smallest buffer for the getdents64 syscall
+#define MAX_DIRENT_BUFFER 1048576 //1 MiB, the largest buffer for the getdents64 syscall
+#define STREAM_DIRENT_BUFFER 65536 //64 KiB, the buffer of the streaming mode, which bounds the entries that are held at once
+
+/* The size of the output buffer, which is written to the stdout with a single write syscall when it is full */
+#define OUTPUT_BUFFER_SIZE 65536
+
+/* The time zone files, which are read instead of calling the localtime() for each file */
+#define LOCAL_ZONE_FILE "/etc/localtime"       //the time zone of the system, when the TZ is not set
+#define ZONE_DIRECTORY "/usr/share/zoneinfo/"  //the directory of the time zone files, for the TZ
+#define MAX_ZONE_FILE 1048576                  //the time zone files are much smaller than 1 MiB
+#define TZIF_HEADER_SIZE 44                    //the size of the header of the TZif file
+
+/* The fields of the output, which are selected with the -o option (the name is always printed) */
+#define FIELD_MODE 1   //the file type and the file permission
+#define FIELD_LINKS 2  //the number of hard links
+#define FIELD_UID 4    //the user id
+#define FIELD_GID 8    //the group id
+#define FIELD_SIZE 16  //the size of the file
+#define FIELD_TIME 32  //the last modified time
+#define ALL_FIELDS 63  //the fields of the "ls -n" (the default output), which are read from the file stat
+#define FIELD_INODE 64 //the inode number (from the directory entry)
+#define FIELD_TYPE 128 //the file type (from the directory entry)
+
+/* The request mask of the statx syscall and its flag, from the linux man page */
+#define STATX_TYPE 0x1U
+#define STATX_MODE 0x2U
+#define STATX_NLINK 0x4U
+#define STATX_UID 0x8U
+#define STATX_GID 0x10U
+#define STATX_MTIME 0x40U
+#define STATX_CTIME 0x80U
+#define STATX_INO 0x100U
+#define STATX_SIZE 0x200U
+#define AT_STATX_DONT_SYNC 0x4000 //use the cached attributes, instead of synchronising them with the server
+#define ENOSYS_ERROR -38          //the statx syscall is not supported by the kernel (older than Linux 4.11)
+
+/* The widths of the columns in the streaming mode (the -S option), which fit the largest value of each type */
+#define STREAM_LINK_WIDTH 10  //the number of links is 32-bit
+#define STREAM_ID_WIDTH 10    //the uid and the gid are 32-bit
+#define STREAM_SIZE_WIDTH 20  //the size and the inode number are 64-bit
+
+#define SORT_NONE 0   //the order of the getdents64 syscall (the default)
+#define SORT_NAME 1   //the names in the byte order (just like "LC_ALL=C ls")
+#define SORT_TIME 2   //the newest first
+#define SORT_SIZE 3   //the largest first
+#define SORT_INODE 4  //the smallest inode number first
+#define RADIX_BUCKETS 256 //the radix sort sorts the 64-bit keys one byte at a time
+#define NAME_PREFIX 8     //the number of bytes of the names that are packed into each key of the radix sort
+#define SMALL_SORT 32     //the groups that are smaller than this are sorted with the insertion sort
+
+#define CACHE_MAGIC 0x32584449534c594dUL //"MYLSIDX2", the first 8 bytes of the cache file (the version of its layout)
+#define CACHE_DIRENT 0x80000000U        //the mask of a cache file of the directory entries, which were not stat-ed (unlike STATX_INO, the links are not followed)
+#define CACHE_FILE_FLAG (O_WRONLY | O_CREAT | O_TRUNC)
+#define CACHE_FILE_MODE 0644
+#define CACHE_MAP_FLAG MAP_PRIVATE      //the cached columns are copy-on-write, so the hot entries are updated in place
+#define CACHE_HOT_SECONDS 60            //the entries that changed in the last minute are stat-ed again, even if the directory has not changed
+#define CACHE_MAX_AGE 600               //the file stats that were read more than 10 minutes ago are never reused, so the staleness is bounded
+
+/* The parallel stat (the -P option) */
+#define MAX_STAT_WORKERS 64        //the maximum number of workers that could be given with the -P option
+#define STAT_WORKER_STACK 65536    //64 KiB, the stack of each worker thread
+#define STAT_BATCH 64              //the number of entries that a worker takes at once
+
+/* The initial capacities of the entry table, which doubles when it is full */
+#define INITIAL_ENTRIES 256
+#define INITIAL_NAME_POOL 4096
+
+/* flags of the openat syscall */
+#define DIR_FLAG (O_RDONLY | O_DIRECTORY) //this will be used to open the directory for the ls command
 
 /* 
- * The struct for the getdents syscall 
+ * The struct for the getdents64 syscall 
  * I found this struct from the linux man page.
  *
  * @reference http://man7.org/linux/man-pages/man2/getdents.2.html
  */
-struct linux_dirent {
-    long d_ino;                /* Inode number */
-    off_t d_off;               /* Offset to next linux_dirent */
-    unsigned short d_reclen;   /* Length of this linux_dirent */
+struct linux_dirent64 {
+    unsigned long d_ino;       /* 64-bit inode number */
+    long d_off;                /* 64-bit offset to next structure */
+    unsigned short d_reclen;   /* Size of this dirent */
+    unsigned char d_type;      /* File type */
     char d_name[];             /* Filename (null-terminated) */
 };
 
-/* struct to store the file stat strings */
-struct fileStat {
-    char *fileInfo; // file permission, number of hard links, user id, group id
-    char *link;     // the number of hard links
-    char *uid;      // the user id
-    char *gid;      // the group id
-    char *modTime;  // the last modified time
-    char *fileName; // the name of the file
-    char *fileSize; // the size of the file
-    struct fileStat *next; // pointer that points to the next node
+/*
+ * The struct for the statx syscall
+ * I found this struct from the linux man page.
+ *
+ * @reference http://man7.org/linux/man-pages/man2/statx.2.html
+ */
+struct statxTimestamp {
+    long tv_sec;               /* Seconds since the Epoch (UNIX time) */
+    unsigned int tv_nsec;      /* Nanoseconds since tv_sec */
+    int reserved;
 };
 
-/* The global variables for the custom memory allocating function */
-char *heap;             //the pointer that points the custom heap
-char *brkp = NULL;      //the pointer that points the custom break of the heap
-char *endp = NULL;      //the pointer that points the end of the custom heap
-
-/* The global variables that will be used for printing out the file stat with a suitable length */
-struct fileStat *fs = NULL;
-struct fileStat *currentNode = NULL;
-char lengthOfFileSize = 0;   //maximum digits of the file size
-char lengthOfLink = 0;       //maximum digits of the number of hard links
-char lengthOfUID = 0;        //maximum digits of the user id
-char lengthOfGID = 0;        //maximum digits of the group id
-int currentYear;             //the time as the number of years since 1900
+struct linux_statx {
+    unsigned int stx_mask;              /* Mask of bits indicating filled fields */
+    unsigned int stx_blksize;           /* Block size for filesystem I/O */
+    unsigned long stx_attributes;       /* Extra file attribute indicators */
+    unsigned int stx_nlink;             /* Number of hard links */
+    unsigned int stx_uid;               /* User ID of owner */
+    unsigned int stx_gid;               /* Group ID of owner */
+    unsigned short stx_mode;            /* File type and mode */
+    unsigned short pad;
+    unsigned long stx_ino;              /* Inode number */
+    unsigned long stx_size;             /* Total size in bytes */
+    unsigned long stx_blocks;           /* Number of 512B blocks allocated */
+    unsigned long stx_attributes_mask;  /* Mask to show what's supported in stx_attributes */
+    struct statxTimestamp stx_atime;    /* Last access */
+    struct statxTimestamp stx_btime;    /* Creation */
+    struct statxTimestamp stx_ctime;    /* Last status change */
+    struct statxTimestamp stx_mtime;    /* Last modification */
+    unsigned int stx_rdev_major;        /* Major ID (if this file is a device) */
+    unsigned int stx_rdev_minor;        /* Minor ID (if this file is a device) */
+    unsigned int stx_dev_major;         /* Major ID of the filesystem where the file resides */
+    unsigned int stx_dev_minor;         /* Minor ID of the filesystem where the file resides */
+    unsigned long spare[14];
+};
 
-/* function prototype */
-int printOut(char *);             //a wrapper function of write() system call.
-int checkFileStat(char *, char);  //a wrapper function of stat() system call.
-int openDirectory(char *);        //a wrapper function of open() system call.
+/*
+ * struct for the job of the parallel stat. The names of the directory are already in the entry table,
+ * and the workers take the slots of the entries in batches, so each result lands in the slot of its entry.
+ */
+struct statJob {
+    long dirFd;        //the file descriptor of the listed directory
+    long next;         //the next index of the slots that is not taken by any worker
+    long end;          //the number of the slots to stat
+    int *status;       //the result of the statx syscall of each slot (relative to the first slot)
+    long first;        //the first slot of the directory
+    unsigned int *order; //the slots to stat (in the inode order, with the -I option), or NULL for every slot from the first one
+};
 
-/* The string array for the months */
-const char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+/* struct for a worker thread of the parallel stat */
+struct statWorker {
+    int tid;           //the thread id, which is cleared by the kernel when the thread exits
+};
 
-/**
- * This function initialises the global variables for the custom memory allocating function.
- * The mmap syscall is used to initialise the custom heap memory.
+/*
+ * struct for a directory that is waiting to be listed by the recursive listing (the -R option).
+ * The pending directories form a stack, which is allocated from the walk arena together with their paths.
  */
-void initHeap() {
-    char *ptr = NULL;
-    unsigned long fd = -1;
-    unsigned long offset = 0;
+struct pendingDir {
+    char *path;               //the path of the directory
+    struct pendingDir *below; //the next directory of the stack
+    struct arenaMark end;     //the mark of the walk arena right after this directory
+};
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) MMAP_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == NULL
-        "movq %3, %%rsi\n\t" // %3 == (unsigned long) MAX_HEAP_SIZE
-        "movq %4, %%rdx\n\t" // %4 == (unsigned long) CUSTOM_PROT
-        "movq %5, %%r10\n\t" // %5 == (unsigned long) MMAP_FLAG
-        "movq %6, %%r8\n\t"  // %6 == fd
-        "movq %7, %%r9\n\t"   // %7 == offset
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ptr
-        : "=r"(ptr)          /* if the syscall success, the memory address of the mapped memory will be stored in the ptr */
-        : "r"((long)MMAP_SYSCALL), "r"(NULL), "r"((unsigned long)MAX_HEAP_SIZE), "r"((unsigned long)CUSTOM_PROT), "r"((unsigned long)MMAP_FLAG), "r"(fd), "r"(offset)
-        : "%rax", "%rdi", "%rsi", "%rdx", "%r10", "%r8", "%r9", "memory");
+/*
+ * struct for the header of the cache file of a directory (the -C option). The header is followed by the columns
+ * of the entry table (see cacheLayout()), so an unchanged directory is listed straight from the mapped file.
+ */
+struct cacheHeader {
+    unsigned long magic;          //CACHE_MAGIC
+    unsigned int mask;            //the statx fields that are stored in the columns
+    unsigned int devMajor;        //the device of the directory ...
+    unsigned int devMinor;
+    unsigned int pad;
+    unsigned long ino;            //... and its inode number, which also name the cache file
+    struct statxTimestamp mtime;  //the last modified time of the directory when it was read
+    struct statxTimestamp ctime;  //the last status change of the directory when it was read
+    long snapshot;                //the time just before the directory was read
+    long verified;                //the time when the oldest file stats of the columns were read (reused entries keep their time)
+    long count;                   //the number of entries
+    long nameLength;              //the number of bytes of the name pool
+    unsigned long maxLink;        //the maximums of the columns, so the widths are known without reading the columns
+    unsigned long maxUid;
+    unsigned long maxGid;
+    unsigned long maxSize;
+    unsigned long maxInode;
+};
 
-    heap = ptr;
-    brkp = ptr;
-    endp = ptr + MAX_HEAP_SIZE;
-}
+/* struct for a DST transition rule of the POSIX TZ string (i.e. "M3.2.0/2"), which gives the transition in every year */
+struct zoneRule {
+    char kind;   //'M' for Mm.w.d, 'J' for Jn (February 29 is never counted), 'D' for n (the zero-based day of the year)
+    int month;   //the month (1 - 12) of the Mm.w.d rule
+    int week;    //the week (1 - 5, 5 is the last week) of the Mm.w.d rule
+    int day;     //the day of the week (0 is Sunday) of the Mm.w.d rule, or the day of the year of the Jn and n rules
+    long time;   //the local time of the transition in seconds (02:00:00 by default)
+};
 
-/**
- * This function is a wrapper function of the munmap system call.
- * The aim of this function is to unmap the mapped memory by using the syscall munmap.
- *
- * @return ret If the munmap syscall success, returns 0. Otherwise, returns -1.
+/*
+ * struct for the time zone, which is loaded from the TZif file once.
+ * The offset of the last lookup is cached with the range of the UTC times that it is valid for,
+ * so the files with nearby modified times do not search the transitions again.
  */
-int myUnMap() {
-    long ret = -1;
+struct timeZone {
+    char loaded;               //0 if the time zone could not be loaded (then the localtime() is used)
+    long count;                //the number of transitions
+    long *transitions;         //the UTC times of the transitions
+    unsigned char *types;      //the local time type after each transition
+    long *typeOffsets;         //the offset from UTC (in seconds, east is positive) of each local time type
+    long typeCount;            //the number of local time types
+    char hasRule;              //1 if the POSIX TZ string gives the local time after the last transition
+    char hasDst;               //1 if the POSIX TZ string has the daylight saving time
+    long stdOffset;            //the offset of the standard time of the POSIX TZ string
+    long dstOffset;            //the offset of the daylight saving time of the POSIX TZ string
+    struct zoneRule start;     //the start of the daylight saving time
+    struct zoneRule end;       //the end of the daylight saving time
+    long cacheFrom;            //the cached offset is valid from this UTC time ...
+    long cacheUntil;           //... until this UTC time
+    long cacheOffset;          //the cached offset
+};
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) MUNMAP_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == (unsigned long) heap
-        "movq %3, %%rsi\n\t" // %3 == (unsigned long) MAX_HEAP_SIZE
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)MUNMAP_SYSCALL), "r"((unsigned long) heap), "r"((unsigned long) MAX_HEAP_SIZE)
-        : "%rax", "%rdi", "%rsi", "memory");
+/*
+ * struct for the table of the file stats of the listed files.
+ * Each field is stored in its own contiguous array (struct of arrays), and the names are stored in a single name pool.
+ * The fields are stored as raw numbers, and they are formatted when they are printed out, after the widths of the columns are known.
+ */
+struct entryTable {
+    mode_t *mode;              //the file types and the file permissions
+    unsigned long *link;       //the numbers of hard links
+    uid_t *uid;                //the user ids
+    gid_t *gid;                //the group ids
+    unsigned long *size;       //the sizes of the files
+    time_t *modTime;           //the last modified times
+    time_t *changeTime;        //the last status changes (only with the -C option)
+    unsigned long *inode;      //the inode numbers
+    char *isDir;               //1 if the entry is a sub-directory (not a symbolic link), which is listed with the -R option
+    unsigned int *nameOffset;  //the offsets of the names in the name pool
+    char *names;               //the name pool, which stores the null-terminated names
+    long count;                //the number of entries
+    long capacity;             //the number of entries that the arrays can store
+    long nameLength;           //the number of used bytes of the name pool
+    long nameCapacity;         //the size of the name pool
+    unsigned long maxLink;     //the maximum of the link (to find the width of the column)
+    unsigned long maxUid;      //the maximum of the uid
+    unsigned long maxGid;      //the maximum of the gid
+    unsigned long maxSize;     //the maximum of the size
+    unsigned long maxInode;    //the maximum of the inode number
+};
 
-    return ret;
-}
+/* The global variables for the custom memory allocating function */
+char showStats = 0;     //set by the -T option, prints out the usage of the custom heap
+long direntCalls = 0;   //the number of the getdents64 syscalls (printed out with the -T option)
+long direntCount = 0;   //the number of the directory entries that were read by them
+long statCalls = 0;     //the number of the statx (or newfstatat) syscalls
+
+/* The global variables for the output buffer */
+char outputBuffer[OUTPUT_BUFFER_SIZE]; //the lines are formatted in this buffer before they are written to the stdout
+long outputLength = 0;                 //the number of bytes in the output buffer
+char unbufferedOutput = 0;             //set by the -u option, writes every line as soon as it is formatted
+
+/* The global variables for the file stats */
+int outputFields = ALL_FIELDS;  //the fields of the output (the -o option)
+unsigned int statxMask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_MTIME; //the request mask of the statx syscall, which only has the fields of the output
+int statxFlags = 0;             //AT_STATX_DONT_SYNC with the -D option
+char statxMissing = 0;          //1 if the kernel does not support the statx syscall
+int sortKey = SORT_NONE;        //the key of the sort (the -s option)
+char reverseOrder = 0;          //set by the -r option, reverses the order of the sort
+long topCount = -1;             //the number of the entries to print out (the -N option), or -1 for every entry
+unsigned int *entryOrder = NULL; //the sorted slots of the entry table, or NULL for the order of the entry table
+char streamOutput = 0;          //set by the -S option, prints out the entries of each getdents64 buffer before reading the next one
+char direntOnly = 0;            //1 if the output only has the names, the types and the inode numbers, so the directory is printed from the getdents64 buffer
+int statWorkers = 1;            //the number of the workers of the parallel stat (the -P option)
+struct statJob statJob;         //the job of the parallel stat
+char inodeOrder = 0;            //set by the -I option, reads the file stats in the order of the inode numbers
+char recursive = 0;             //set by the -R option, lists the sub-directories as well
+char *cacheDirectory = NULL;    //the directory of the cache files (the -C option), or NULL
+struct arena walkArena;         //the stack of the pending directories of the recursive listing
+long outputWrites = 0;                 //the number of write syscalls for the stdout (printed out with the -T option)
 
-/**
- * The aim of this function is to move the break of the custom heap to allocate the memory dynamically.
- *
- * To implement this custom sbrk function, I copied some of the codes from the following article.
- * @reference <https://people.kth.se/~johanmon/ose/assignments/maplloc.pdf>
- */
-void *mysbrk(size_t size) {
-    if (size == 0) {
-        return (void *) brkp;
-    }
+/* The global variables that will be used for printing out the file stat with a suitable length */
+struct entryTable entries;   //the file stats of the listed files of the current operand
+long currentTime;            //the current time (since the epoch)
+int currentYear;             //the time as the number of years since 1900
+char *listPrefix = "";       //the path of the listed directory, which is printed before the names of its files
+
+/* The global variables for the directory cache (the -C option) */
+struct cacheHeader *cacheMap = NULL; //the mapped cache file of the listed directory, or NULL
+long cacheMapSize = 0;               //the size of the mapped cache file
+struct entryTable cachedEntries;     //the columns of the mapped cache file
+unsigned int *cacheIndex = NULL;     //the hash table of the cached names (slot + 1, or 0) of a changed directory, whose entries are reused
+long cacheIndexMask = 0;             //the size of the hash table minus 1
+long cacheHits = 0;                  //the number of the directories that were listed from their cache files
+long cacheReused = 0;                //the number of the entries of the changed directories that were not stat-ed again
+long cacheWrites = 0;                //the number of the written cache files
+
+/* The global variables for the timestamp formatter */
+struct timeZone localZone;          //the local time zone
+char timeCache[13];                 //the last formatted modified time (i.e. "17 Oct 11:50 ")
+long cachedMinute = LONG_MIN;       //the local minute (since the epoch) of the timeCache
+long cachedDay = LONG_MIN;          //the local day (since the epoch) of the first 7 bytes of the timeCache
+char cachedThisYear = 0;            //1 if the cached day is in the current year, so the time is printed instead of the year
 
-    void *memp = (void *)brkp;
-    brkp += size;       //move the brkp to allocate memory
-    if (brkp >= endp) { //to check if there is empty space in the heap
-        brkp -= size;   //move back the brkp
-        return NULL;    //returns NULL if there is no free space in the heap
-    }
+/* function prototype */
+int printOut(const char *);       //appends the string to the output buffer.
+void flushOutput();               //writes the output buffer with the write() system call.
+int checkFileStat(long, char *, char); //reads the file stat with statx() system call.
+int openDirectory(char *);        //a wrapper function of openat() system call.
+long appendEntry(struct entryTable *, char *); //appends the name to the entry table.
+void statEntries(long, long, unsigned int *, long); //reads the file stats of the entries in parallel.
+void radixSort(unsigned long *, unsigned int *, unsigned long *, unsigned int *, long); //sorts the slots by their 64-bit keys.
+void printDirent(long, struct linux_dirent64 *); //prints out the directory entry without its file stat.
+void appendDirent(long, struct linux_dirent64 *); //appends the directory entry to the entry table without its file stat.
+char isDirectoryEntry(long, struct linux_dirent64 *); //checks if the directory entry is a sub-directory.
+void printEntries();              //prints out the entries of the entry table.
+long reuseCachedEntries(long, unsigned int *); //copies the cached file stats of the entries that have not changed.
+int getCurrentTime();             //a wrapper function of time() system call.
 
-    return memp;
-}
+/* The string array for the months */
+const char *months[12] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
 
+/* The file type characters, indexed by the d_type of the directory entry (or by the S_IFMT bits of the mode, shifted by 12) */
+const char fileTypes[17] = "?pc?d?b?-?l?s???";
+
+/* The table of the two-digit decimal strings, so that the numbers are converted two digits at a time */
+const char digitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* The table of the powers of 10, which is used to count the digits of the numbers */
+const unsigned long powersOfTen[20] = {
+    1UL, 10UL, 100UL, 1000UL, 10000UL, 100000UL, 1000000UL, 10000000UL, 100000000UL, 1000000000UL,
+    10000000000UL, 100000000000UL, 1000000000000UL, 10000000000000UL, 100000000000000UL,
+    1000000000000000UL, 10000000000000000UL, 100000000000000000UL, 1000000000000000000UL,
+    10000000000000000000UL
+};
 
 /**
- * The custom strlen function.
+ * This function is a wrapper function of the mmap system call, which maps the given file copy-on-write (the cache files).
  *
- * @param str the string to check it's length
- * @return the length of the string
+ * @param fd the file descriptor of the opened file
+ * @param size the number of bytes to map
+ * @return On success, the address of the mapped file is returned. On error, -errno will be returned.
  */
-int strlength(const char *str) {
-    int count = 0;
-
-    while (*str != '\0') { //iterate the while loop until it reaches to the terminator character
-        count += 1;
-        str += 1;
-    }
-
-    return count;
+long mapFile(long fd, long size) {
+    return mapRegion(size, PROT_READ | PROT_WRITE, CACHE_MAP_FLAG, fd, 0);
 }
 
 /**
- * The aim of this function is to copy the string to the new string.
+ * This function allocates the memory from the custom heap (see mysbrk() in common.h).
+ * The allocation never returns NULL to the caller: if the mmap syscall fails, the myls is terminated with the error message.
  *
- * @param str the pointer that points the new string
- * @param s the pointer that points the string that contains the value that should be copied
- * @param length the length of the string that should be copied
+ * @param size the number of bytes to allocate
+ * @return the allocated memory
  */
-void strcopy(char *str, const char *s, int length) {
-    for (int i = 0; i < length; i++) {
-        *str = *s;
-        str += 1;
-        s += 1;
+void *allocateMemory(size_t size) {
+    void *memp = mysbrk(size);
+
+    if (memp == NULL) {
+        flushOutput(); //the lines of the previous operands are not lost
+        printErr("myls: out of memory\n");
+        exitProcess(1);
     }
+
+    return memp;
 }
 
 /**
@@ -189,7 +382,7 @@ char *strconcat(const char *str1, const char *str2) {
     int length2 = strlength(str2);          //check the length of the second string
     int length = length1 + length2 + 1;     // add 1 for the terminator.
 
-    char *newStr = (char *) mysbrk(length); //dynamically allocate the memory to concatenate strings
+    char *newStr = (char *) allocateMemory(length); //dynamically allocate the memory to concatenate strings
     char *temp = newStr;
 
     strcopy(temp, str1, length1);           //copy the characters in the first string to the new string
@@ -204,110 +397,178 @@ char *strconcat(const char *str1, const char *str2) {
 }
 
 /**
- * This function compares the two strings.
+ * This function opens the directory by using the openat syscall.
+ * The openDirectory() will be used to open the directory for the ls command, and the files in it are
+ * checked relative to the returned file descriptor.
+ * 
+ * @param name the name of the directory that should be opened for the ls command
+ * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. Otherwise, returns some negative value.
+ */
+int openDirectory(char *name) {
+    return syscall3(OPENAT_SYSCALL, AT_FDCWD, (long) name, DIR_FLAG);
+}
+
+/**
+ * This function opens the file for reading by using the openat syscall.
+ *
+ * @param name the path of the file
+ * @return If the syscall success, the file descriptor will be returned. Otherwise, returns -errno.
+ */
+int openFile(const char *name) {
+    return syscall3(OPENAT_SYSCALL, AT_FDCWD, (long) name, O_RDONLY);
+}
+
+/**
+ * This function creates (or truncates) the file for writing by using the openat syscall.
  *
- * @param str1 the pointer that points to the first string
- * @param str2 the pointer that points to the second string
+ * @param name the path of the file
+ * @return If the syscall success, the file descriptor will be returned. Otherwise, returns -errno.
+ */
+int createFile(const char *name) {
+    return syscall4(OPENAT_SYSCALL, AT_FDCWD, (long) name, CACHE_FILE_FLAG, CACHE_FILE_MODE);
+}
+
+/**
+ * This function is a wrapper function of the rename system call, which replaces the new path atomically.
  *
- * @return Returns an integer less than, equal to, or greater than zero if str1 is found, 
- *         respectively, to be less than, to match, or be greater than str2.
+ * @param oldName the current path of the file
+ * @param newName the new path of the file
+ * @return On success, zero is returned. On error, -errno is returned.
  */
-int strCompare(const char *str1, const char *str2) {
-    int i = 0;
+int renameFile(const char *oldName, const char *newName) {
+    return syscall2(RENAME_SYSCALL, (long) oldName, (long) newName);
+}
 
-    while (str1[i] != '\0') {
-        if (str1[i] != str2[i]) {
-            break;
-        }
-        i += 1;
-    }
+/**
+ * This function is a wrapper function of the unlink system call.
+ *
+ * @param name the path of the file to remove
+ * @return On success, zero is returned. On error, -errno is returned.
+ */
+int removeFile(const char *name) {
+    return syscall1(UNLINK_SYSCALL, (long) name);
+}
 
-    return (str1[i] - str2[i]);
+/**
+ * This function is a wrapper function of the getpid system call.
+ *
+ * @return the process id of the myls
+ */
+long getProcessId() {
+    return syscall0(GETPID_SYSCALL);
 }
 
 /**
- * This function opens the file by using the syscall.
- * The openDirectory() will be used to open the directory for the ls command.
- * This function uses the extended inline assembler to make interaction with the kernel more explicit.
- * 
- * @param name the name of the directory that should be opened for the ls command
- * @return ret If the syscall success, the lowest numbered unused file descriptor will be returned. Otherwise, returns some negative value.
+ * This function chooses the size of the getdents64 buffer from the st_size of the opened directory.
+ * The size starts from MIN_DIRENT_BUFFER and doubles until it covers twice the st_size (the linux_dirent64
+ * is bigger than the entry on the disk) or reaches MAX_DIRENT_BUFFER, so most directories are read with a single syscall.
+ *
+ * @param fd the file descriptor of the directory
+ * @return the size of the buffer
  */
-int openDirectory(char *name) {
-    long ret = -1;
-    int flag = O_RDONLY;
-    int mode = OPEN_MODE;
-
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = name
-        "movq %3, %%rsi\n\t" // %3 = flag
-        "movq %4, %%rdx\n\t" // %4 = mode
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)OPEN_SYSCALL), "r"(name), "r"((long)flag), "r"((long)mode) //convert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+long chooseDirentSize(long fd) {
+    long size = MIN_DIRENT_BUFFER;
+    struct stat statBuffer;
 
-    return ret;
+    if (checkFdStat(fd, &statBuffer) == 0) {
+        while (size < statBuffer.st_size * 2 && size < MAX_DIRENT_BUFFER) {
+            size *= 2;
+        }
+    }
+
+    return size;
 }
 
 /**
- * This function is a wrapper function of the getdents system call.
- * The system call getdents() reads several linux_dirent structures from
+ * This function is a wrapper function of the getdents64 system call.
+ * The system call getdents64() reads several linux_dirent64 structures from
  * the directory referred to by the open file descriptor into the buffer.
+ * The buffer is sized from the directory and allocated from the heap, so it is released with the stats of the operand.
+ * Each file is checked relative to that file descriptor, so the path names of the files are never built.
+ * If the output only has the fields of the directory entries (i.e. "-o type,name"), each entry is printed as soon as it is decoded.
+ * In the streaming mode (the -S option), the entries of each buffer are printed out before the next getdents64 syscall,
+ * so the entry table never holds more than one buffer of entries.
  *
- * @param directoryName the name of the target directory.
+ * @param fd the file descriptor of the target directory.
  */
-void getDirectoryEntries(char *directoryName) {
+void getDirectoryEntries(long fd) {
     long nread = -1;
-    int bpos;
-    char buf[GETDENT_BUFFER_SIZE];
-    struct linux_dirent *ld;
-
-    long fd = openDirectory(directoryName);
+    long bpos;
+    long size = streamOutput ? STREAM_DIRENT_BUFFER : chooseDirentSize(fd);
+    char *buf = (char *) allocateMemory(size);
+    struct linux_dirent64 *ld;
+    long first = entries.count;
+    //the names are collected first, and their stats are read by the workers (in the inode order, with the -I option)
+    char parallel = ((statWorkers > 1 || inodeOrder || cacheIndex != NULL) && statxMask != 0 && !direntOnly);
 
     for (;;) {
         /* 
-        * If the system call success, the getdents syscall returns the number of bytes read. 
-        * On end of directory, the getdents syscall returns 0. 
+        * If the system call success, the getdents64 syscall returns the number of bytes read. 
+        * On end of directory, the getdents64 syscall returns 0. 
         * Otherwise, it returns -1.
         */
-        asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-            "movq %2, %%rdi\n\t" // %2 = fd
-            "movq %3, %%rsi\n\t" // %3 = buf
-            "movq %4, %%rdx\n\t" // %4 = (long) GETDENT_BUFFER_SIZE
-            "syscall\n\t"
-            "movq %%rax, %0\n\t"
-            : "=r"(nread)
-            : "r"((long)GETDENTS_SYSCALL), "r"(fd), "r"(buf), "r"((unsigned long)GETDENT_BUFFER_SIZE)
-            : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-        if (nread == -1) {
-            char errorMsg[40] = "Error occurred in the getdents syscall\n";
+        nread = syscall3(GETDENTS64_SYSCALL, fd, (long) buf, size);
+
+        direntCalls += 1;
+
+        if (nread < 0) {
+            char errorMsg[42] = "Error occurred in the getdents64 syscall\n";
             printOut(errorMsg); //print out the error message
             break;
-        } else if (nread == 0) { //check if the getdents syscall is on the end of the directory
+        } else if (nread == 0) { //check if the getdents64 syscall is on the end of the directory
             break;
         }
 
         for (bpos = 0; bpos < nread;) {
-            ld = (struct linux_dirent *)(buf + bpos);
+            ld = (struct linux_dirent64 *)(buf + bpos);
+            direntCount += 1;
 
             if ((strCompare(ld->d_name, ".") != 0) && (strCompare(ld->d_name, "..") != 0)) {
-
-                if (*directoryName == '.' && *(directoryName+1) == '\0') {
-                    checkFileStat(ld->d_name, 0);
+                long count = entries.count;
+
+                if (direntOnly && (sortKey != SORT_NONE || recursive || cacheDirectory != NULL)) {
+                    appendDirent(fd, ld);
+                } else if (direntOnly) {
+                    printDirent(fd, ld);
+                } else if (parallel) {
+                    long i = appendEntry(&entries, ld->d_name);
+                    entries.inode[i] = ld->d_ino; //the key of the inode order
                 } else {
-                    char *str1 = strconcat(directoryName, "/");
-                    char *targetName = strconcat(str1, ld->d_name);
+                    checkFileStat(fd, ld->d_name, 0);
+                }
 
-                    checkFileStat(targetName, 0);
+                if ((recursive || cacheDirectory != NULL) && entries.count > count) {
+                    entries.isDir[count] = isDirectoryEntry(fd, ld);
                 }
             }
 
             bpos += ld->d_reclen;
         }
 
+        if (streamOutput && !direntOnly) { //print out this buffer, and reuse the entry table for the next one
+            if (parallel) {
+                statEntries(fd, first, NULL, 0);
+            }
+
+            printEntries();
+            flushOutput();
+
+            entries.count = 0;
+            entries.nameLength = 0;
+            first = 0;
+        }
+    }
+
+    if (parallel && !streamOutput) {
+        unsigned int *fresh = NULL;
+        long freshCount = 0;
+
+        if (cacheIndex != NULL) { //the entries that have not changed since the cache file was written are not stat-ed again
+            fresh = (unsigned int *) allocateMemory((entries.count - first) * sizeof(unsigned int) + 1);
+            freshCount = reuseCachedEntries(first, fresh);
+        }
+
+        statEntries(fd, first, fresh, freshCount);
     }
 }
 
@@ -322,409 +583,2292 @@ void convertMonthToStr(int month, char *str) {
 }
 
 /**
- * The aim of this funciton is to check the digits of the given number.
- * @param num the number to check the digits
- * @return i ((the number of digits) - 1)
+ * The aim of this funciton is to count the digits of the given number.
+ * The number of bits of the number gives an estimate of the digits (log10(2) is about 1233 / 4096),
+ * which is corrected by comparing the number with the table of the powers of 10.
+ *
+ * @param num the number to count the digits
+ * @return the number of digits (1 for 0)
  */
-int checkDigits(int num) {
-    int i = 0, j = 10;
-
-    while (j <= num) {
-        j *= 10;
-        i += 1;
-    }
+int countDigits(unsigned long num) {
+    int bits = 64 - __builtin_clzl(num | 1);
+    int digits = (bits * 1233) >> 12;
 
-    return i;
+    return digits + ((num | 1) >= powersOfTen[digits]);
 }
 
 /**
- * This function converts the type of the given integer from in to string.
+ * This function converts the given number to the decimal string, by looking up two digits at a time from the digitPairs table.
+ * If the number has fewer digits than the given number of digits, it is padded with zeros. The terminator is not appended.
  *
  * @param str the pointer points to the string
+ * @param digits the number of digits to write (at least the countDigits() of the number)
  * @param num the target number
- * @return i the digits of the given number
  */
-int convertNumToStr(char *str, int num) {
-    int i = 0, j = checkDigits(num);
+void formatDecimal(char *str, int digits, unsigned long num) {
+    char *p = str + digits;
+
+    while (num >= 100) {
+        const char *pair = digitPairs + (num % 100) * 2;
+        num /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
 
-    while (num) {
-        *(str + j) = (char) ('0' + (num % 10));
-        num /= 10;
-        i += 1;
-        j -= 1;
+    if (num >= 10) {
+        *--p = digitPairs[num * 2 + 1];
+        *--p = digitPairs[num * 2];
+    } else {
+        *--p = (char) ('0' + num);
     }
 
-    return i;
+    while (p > str) {
+        *--p = '0';
+    }
 }
 
 /**
- * This function checks the file permission of the particular file and convert the file permission to the string.
+ * This function prints the number in the column with the given width (right-aligned), followed by a whitespace character.
  *
- * @param fp the pointer that points to the character array
- * @param mode the variable that shows the file permission of the specific file.
+ * @param str the pointer points to the string
+ * @param width the width of the column
+ * @param num the target number
+ * @return the pointer to the end of the string
  */
-void checkFilePermission(char *fp, mode_t mode) {
-    if (mode & S_IFDIR) {
-        fp[0] = 'd';
-    } else {
-        fp[0] = '-';
-    }
-
-    if (mode & S_IRUSR) {
-        fp[1] = 'r';
-    } else {
-        fp[1] = '-';
-    }
-
-    if (mode & S_IWUSR) {
-        fp[2] = 'w';
-    } else {
-        fp[2] = '-';
-    }
-
-    if (mode & S_IXUSR) {
-        fp[3] = 'x';
-    } else {
-        fp[3] = '-';
-    }
-
-    if (mode & S_IRGRP) {
-        fp[4] = 'r';
-    } else {
-        fp[4] = '-';
-    }
+char *formatColumn(char *str, int width, unsigned long num) {
+    int digits = countDigits(num);
 
-    if (mode & S_IWGRP) {
-        fp[5] = 'w';
-    } else {
-        fp[5] = '-';
+    for (int i = digits; i < width; i++) {
+        *str++ = ' ';
     }
 
-    if (mode & S_IXGRP) {
-        fp[6] = 'x';
-    } else {
-        fp[6] = '-';
-    }
+    formatDecimal(str, digits, num);
+    str += digits;
+    *str++ = ' ';
 
-    if (mode & S_IROTH) {
-        fp[7] = 'r';
-    } else {
-        fp[7] = '-';
-    }
+    return str;
+}
 
-    if (mode & S_IWOTH) {
-        fp[8] = 'w';
-    } else {
-        fp[8] = '-';
-    }
+/**
+ * This function divides the given number, rounding the quotient down (towards the negative infinity),
+ * so that the times before the epoch fall into the right day.
+ *
+ * @param num the dividend
+ * @param divisor the divisor (positive)
+ * @return the quotient
+ */
+long floorDivide(long num, long divisor) {
+    long q = num / divisor;
 
-    if (mode & S_IXOTH) {
-        fp[9] = 'x';
-    } else {
-        fp[9] = '-';
+    if (num % divisor < 0) {
+        q -= 1;
     }
 
-    fp[10] = ' ';
-    fp[11] = '\0';
+    return q;
 }
 
 /**
- * This is a wrapper function of the close syscall.
+ * This function converts the given date of the proleptic Gregorian calendar to the number of days since 1970-01-01.
+ * The year is shifted to start from March, so February 29 is the last day of the shifted year, and the number of days
+ * is counted by the 400-year eras without any table or loop.
  *
- * @param fd the file descriptor of the opened file (or directory)
- * @return Returns zero on success. On error, negative value would be returned, which will depend on the setted error number.
+ * @reference http://howardhinnant.github.io/date_algorithms.html
+ *
+ * @param year the year
+ * @param month the month (1 - 12)
+ * @param day the day of the month (1 - 31)
+ * @return the number of days since 1970-01-01
  */
-int closeFile(long fd) {
-    long ret = -1;
+long daysFromCivil(long year, long month, long day) {
+    year -= (month <= 2);
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) OPEN_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fd
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)OPEN_SYSCALL), "r"(fd)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
+    long era = floorDivide(year, 400);
+    long yearOfEra = year - era * 400;                                          //[0, 399]
+    long dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; //[0, 365]
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;  //[0, 146096]
 
-    return ret;
+    return era * 146097 + dayOfEra - 719468;
 }
 
 /**
- * This function uses the syscall to get the stat of the specific file.
+ * This function converts the number of days since 1970-01-01 to the date of the proleptic Gregorian calendar.
+ * It is the inverse of the daysFromCivil().
  *
- * @param fileName the name of the target file
- * @param openFlag to check if the program should call the open syscall
- * @return On success, zero will be returned. Otherwise, some negative value will be returned.
+ * @reference http://howardhinnant.github.io/date_algorithms.html
+ *
+ * @param days the number of days since 1970-01-01
+ * @param year the pointer to store the year
+ * @param month the pointer to store the month (1 - 12)
+ * @param day the pointer to store the day of the month (1 - 31)
  */
-int checkFileStat(char *fileName, char openFlag) {
-    long ret = -1;
+void civilFromDays(long days, long *year, int *month, int *day) {
+    days += 719468; //the days since 0000-03-01
+
+    long era = floorDivide(days, 146097);
+    long dayOfEra = days - era * 146097;                                                            //[0, 146096]
+    long yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;    //[0, 399]
+    long dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);               //[0, 365]
+    long shiftedMonth = (5 * dayOfYear + 2) / 153;                                                  //[0, 11], from March
+
+    *day = (int) (dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+    *month = (int) (shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+    *year = yearOfEra + era * 400 + (*month <= 2);
+}
 
-    struct stat statBuffer;
+/**
+ * This function finds the local time of the DST transition of the given rule in the given year.
+ *
+ * @param year the year
+ * @param rule the rule of the POSIX TZ string
+ * @return the local time of the transition, in seconds since the epoch
+ */
+long ruleTime(long year, struct zoneRule *rule) {
+    long days = daysFromCivil(year, 1, 1);
+
+    if (rule->kind == 'J') { //Jn, where February 29 is never counted
+        char leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        days += rule->day - 1 + (leap && rule->day >= 60);
+    } else if (rule->kind == 'D') {
+        days += rule->day;
+    } else { //Mm.w.d, the d'th day of the week of the w'th week of the month m
+        long first = daysFromCivil(year, rule->month, 1);
+        long weekday = (first % 7 + 11) % 7; //1970-01-01 was Thursday
+        long next = (rule->month == 12) ? daysFromCivil(year + 1, 1, 1) : daysFromCivil(year, rule->month + 1, 1);
+
+        days = first + (rule->day - weekday + 7) % 7 + (rule->week - 1) * 7;
+
+        while (days >= next) { //the 5th week means the last week of the month
+            days -= 7;
+        }
+    }
 
-    asm("movq %1, %%rax\n\t" // %1 = (long) STAT_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 = fileName
-        "movq %3, %%rsi\n\t" // %3 = statBuffer
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long)STAT_SYSCALL), "r"(fileName), "r"(&statBuffer) //covert the type from int to long for the movq instruction
-        : "%rax", "%rdi", "%rsi", "memory");
+    return days * 86400 + rule->time;
+}
 
-    mode_t mode = statBuffer.st_mode; //mode of file
+/**
+ * This function parses the name of the time zone in the POSIX TZ string (i.e. "EST", or "<+03>").
+ *
+ * @param p the pointer to the name
+ * @return the pointer after the name, or NULL if the name is invalid
+ */
+const char *parseZoneName(const char *p) {
+    const char *start = p;
 
-    //use the bitwise operators to check if the current file is a directory and check if the program should call the open syscall
-    if ( (S_IFDIR & mode) && openFlag) {
+    if (*p == '<') {
+        while (*p != '\0' && *p != '>') {
+            p += 1;
+        }
 
-        int fd = openDirectory(fileName); //open the directory
-        getDirectoryEntries(fileName);
-        closeFile(fd); //close the directory
+        return (*p == '>') ? p + 1 : NULL;
+    }
 
-    } else {
+    while ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z')) {
+        p += 1;
+    }
 
-        uid_t user = statBuffer.st_uid;        //user id
-        gid_t group = statBuffer.st_gid;       //group id
-        time_t modTime = statBuffer.st_mtime;  //last modified time
+    return (p - start >= 3) ? p : NULL;
+}
 
-        struct tm *modT = localtime(&modTime); //struct time of the last modified time
+/**
+ * This function parses the time of the POSIX TZ string, which is [+|-]hh[:mm[:ss]].
+ *
+ * @param p the pointer to the time
+ * @param seconds the pointer to store the time in seconds
+ * @return the pointer after the time, or NULL if the time is invalid
+ */
+const char *parseZoneTime(const char *p, long *seconds) {
+    long sign = 1, value = 0, scale = 3600;
 
-        char *str = (char *)mysbrk(14);
-        char *temp = str;
+    if (*p == '+' || *p == '-') {
+        sign = (*p == '-') ? -1 : 1;
+        p += 1;
+    }
 
-        if (modT->tm_mday < 10) {
-            *str = ' ';
-            temp += 1;
-            *temp++ = (char) (modT->tm_mday + '0');
-        } else {
-            convertNumToStr(temp, modT->tm_mday); //convert the type of the day of the month from number to string
+    for (;;) {
+        long part = 0;
 
-            temp += 2;
+        if (*p < '0' || *p > '9') {
+            return NULL;
         }
 
-        *temp++ = ' ';
-
-        convertMonthToStr(modT->tm_mon, temp); //convert the type of the month from number to string
-
-        temp += 3;
-        *temp++ = ' ';
-
-        if (modT->tm_year != currentYear) {
-            *temp++ = ' ';
-            convertNumToStr(temp, (modT->tm_year + 1900)); //convert the type of the year from number to string
-            temp += 4;
-            *temp++ = ' ';
-            *temp = '\0';
-        } else {
-            
-            if (modT->tm_hour == 0) {
-                *temp++ = '0';
-                *temp++ = '0';
-            } else if (modT->tm_hour < 10) { //check whether the value of the hour of the last modified time is less than 10 or not
-                //if so, append 0 in front of the time string.
-                *temp++ = '0';
-                convertNumToStr(temp++, modT->tm_hour); //convert the type of the hour from number to string
-            } else {
-                convertNumToStr(temp, modT->tm_hour); //convert the type of the hour from number to string
-                temp += 2;
-            }
+        while (*p >= '0' && *p <= '9') {
+            part = part * 10 + (*p - '0');
+            p += 1;
+        }
 
-            *temp++ = ':';
+        value += part * scale;
 
-            if (modT->tm_min == 0) {
-                *temp++ = '0';
-                *temp++ = '0';
-            } else if (modT->tm_min < 10) { //check whether the value of the minute of the last modified time is less than 10 or not
-                //if so, append 0 in front of the time string.
-                *temp++ = '0';
-                convertNumToStr(temp++, modT->tm_min); //convert the type of the minute from number to string
-            } else {
-                convertNumToStr(temp, modT->tm_min); //convert the type of the minute from number to string
-                temp += 2;
-            }
+        if (*p != ':' || scale == 1) {
+            break;
+        }
 
-            *temp++ = ' ';
-            *temp = '\0';
-        }
-
-        currentNode->modTime = str;
-
-        int length = strlength(fileName);
-        currentNode->fileName = (char *)mysbrk(length + 1);
-        strcopy(currentNode->fileName, fileName, length); //copy the file name to the fileName field of the current file stat node.
-
-        char fp[12];
-        checkFilePermission(fp, mode);
-        currentNode->fileInfo = (char *) mysbrk(12); //allocate the memory to store the file permission and the file type
-        strcopy(currentNode->fileInfo, fp, 11);      //copy the file permission string to store it
-
-        int digits_uid = checkDigits(user) + 1;
-        int digits_gid = checkDigits(group) + 1;
-
-        if (digits_gid > lengthOfGID) lengthOfGID = digits_gid;
-        if (digits_uid > lengthOfUID) lengthOfUID = digits_uid;
-
-        char *str_uid = (char *) mysbrk(digits_uid + 2); //allocate the memory for the user id
-        convertNumToStr(str_uid, user);
-        *(str_uid + digits_uid) = ' '; //append whitespace for the output
-        *(str_uid + digits_uid + 1) = '\0'; //append the terminator
-        currentNode->uid = str_uid;
-
-        char *str_gid = (char *) mysbrk(digits_gid + 2); //allocate the memory for the group id
-        convertNumToStr(str_gid, group);
-        *(str_gid + digits_gid) = ' '; //append whitespace for the output
-        *(str_gid + digits_gid + 1) = '\0'; //append the terminator
-        currentNode->gid = str_gid;
-
-        nlink_t links = statBuffer.st_nlink; //get the number of hard links
-        int digits_link = checkDigits(links) + 1;
-        if (digits_link > lengthOfLink) lengthOfLink = digits_link;
-        char *str_link = (char *) mysbrk(digits_link + 2); //allocate the memory for the number of hard links
-        convertNumToStr(str_link, links);
-        *(str_link + digits_link) = ' '; //append whitespace for the output
-        *(str_link + digits_link + 1) = '\0'; //append the terminator
-        currentNode->link = str_link;
-
-        off_t size = statBuffer.st_size; //get the file size
-        int digits_size = checkDigits(size) + 1;
-        if (digits_size > lengthOfFileSize) lengthOfFileSize = digits_size;
-        char *str_size = (char *) mysbrk(digits_size + 2); //allocate the memory for the file size
-        convertNumToStr(str_size, size);
-        *(str_size + digits_size) = ' '; //append whitespace character for the output
-        *(str_size + digits_size + 1) = '\0'; //append the terminator
-        currentNode->fileSize = str_size;
-
-        /* make a new node for the next file (if exist) */
-        struct fileStat *newNode = (struct fileStat *)mysbrk(sizeof(struct fileStat));
-        currentNode->next = newNode;
-        newNode->next = NULL;
-        currentNode = newNode;
+        p += 1;
+        scale /= 60;
     }
 
-    return ret;
-}
-
-/**
- * This function prints out the given string.
- * This function uses the inline assembly function to make interaction with the kernel more explicit.
- * To implement this function, I reused the given code, which is written by Kasim Terzic.
- *
- * @param text the target text that should be printed out
- * @return ret If the syscall success, returns 1. Otherwise, returns -1.
- */
-int printOut(char *text) {
-    size_t len = strlength(text); //Length of our string, which we need to pass to write syscall
-    long handle = 1;              //1 for stdout, 2 for stderr, file handle from open() for files
-    long ret = -1;                //Return value received from the system call
-
-    asm("movq %1, %%rax\n\t" // %1 == (long) WRITE_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == handle
-        "movq %3, %%rsi\n\t" // %3 == text
-        "movq %4, %%rdx\n\t" // %4 == len
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ret
-        : "=r"(ret)          /* if the syscall success, 1 will be stored in the ret. */
-        : "r"((long)WRITE_SYSCALL), "r"(handle), "r"(text), "r"(len)
-        : "%rax", "%rdi", "%rsi", "%rdx", "memory");
-
-    return ret;
+    *seconds = sign * value;
+    return p;
 }
 
 /**
- * This is a wrapper function of the access syscall.
+ * This function parses the number in the DST rule of the POSIX TZ string.
  *
- * @param fileName the name of the file to check if it exists
- * @return If the file exists, returns 0. Otherwise, returns some negative integer
+ * @param p the pointer to the number
+ * @param num the pointer to store the number
+ * @param min the minimum of the number
+ * @param max the maximum of the number
+ * @return the pointer after the number, or NULL if the number is invalid
  */
-int accessToFile(char *fileName) {
-    long ret = -1;
+const char *parseZoneNumber(const char *p, int *num, int min, int max) {
+    int value = 0;
+
+    if (p == NULL || *p < '0' || *p > '9') {
+        return NULL;
+    }
 
-    asm("movq %1, %%rax\n\t"
-        "movq %2, %%rdi\n\t"
-        "movq %3, %%rsi\n\t"
-        "syscall\n\t"
-        "movq %%rax, %0\n\t"
-        : "=r"(ret)
-        : "r"((long) ACCESS_SYSCALL), "r"(fileName), "r"((long) R_OK)
-        : "%rax", "%rdi", "%rsi", "memory");
+    while (*p >= '0' && *p <= '9' && value <= max) {
+        value = value * 10 + (*p - '0');
+        p += 1;
+    }
 
-    return ret;
+    *num = value;
+    return (value >= min && value <= max) ? p : NULL;
 }
 
 /**
- * This is a wrapper function of the time syscall.
- * The aim of this function is to get the current time by using the time system call.
+ * This function parses the DST rule of the POSIX TZ string, which is Mm.w.d, Jn or n, followed by an optional /time.
  *
- * @return ret On success, the value of time in seconds since the Epoch is returned. Otherwise, returns -1.
+ * @param p the pointer to the rule
+ * @param rule the rule to store the parsed rule
+ * @return the pointer after the rule, or NULL if the rule is invalid
  */
-int getCurrentTime() {
-    long ret = -1;
+const char *parseZoneRule(const char *p, struct zoneRule *rule) {
+    rule->kind = 'D';
+    rule->time = 7200; //02:00:00
+
+    if (*p == 'M') {
+        rule->kind = 'M';
+        p = parseZoneNumber(p + 1, &rule->month, 1, 12);
+        p = (p != NULL && *p == '.') ? parseZoneNumber(p + 1, &rule->week, 1, 5) : NULL;
+        p = (p != NULL && *p == '.') ? parseZoneNumber(p + 1, &rule->day, 0, 6) : NULL;
+    } else if (*p == 'J') {
+        rule->kind = 'J';
+        p = parseZoneNumber(p + 1, &rule->day, 1, 365);
+    } else {
+        p = parseZoneNumber(p, &rule->day, 0, 365);
+    }
 
-    asm("movq %1, %%rax\n\t" // %1 == (long) TIME_SYSCALL
-        "movq %2, %%rdi\n\t" // %2 == NULL
-        "syscall\n\t"
-        "movq %%rax, %0\n\t" // %0 == ret
-        : "=r"(ret)
-        : "r"((long)TIME_SYSCALL), "r"(NULL)
-        : "%rax", "%rdi", "memory");
+    if (p != NULL && *p == '/') {
+        p = parseZoneTime(p + 1, &rule->time);
+    }
 
-    return ret;
+    return p;
 }
 
 /**
- * The aim of this function is to append whitespace characters to the string, so that the program could
- * match the number of digits of the fields of file stat (i.e. uid, gid, number of bytes, etc).
+ * This function parses the POSIX TZ string (i.e. "EST5EDT,M3.2.0,M11.1.0"), which is the footer of the TZif file,
+ * or the value of the TZ environment variable. It gives the local time after the last transition of the TZif file.
  *
- * @param length the maximum digits of the string, to calculate the number of required whitespace characters
- * @param str the target string
+ * @param zone the time zone to store the rule
+ * @param str the POSIX TZ string
+ * @return On success, returns 0. Otherwise, returns -1.
  */
-void checkLengthForOutput(int length, char *str) {
-    int lengthOf = strlength(str);
+int parsePosixZone(struct timeZone *zone, const char *str) {
+    long offset;
+    const char *p = parseZoneName(str);
+
+    if (p == NULL || (p = parseZoneTime(p, &offset)) == NULL) {
+        return -1;
+    }
+
+    zone->stdOffset = -offset; //the POSIX offset is positive to the west of UTC
+    zone->dstOffset = zone->stdOffset + 3600;
+    zone->hasDst = 0;
 
-    //allocate the memory dynamically, to append whitespace characters by using character pointer that points to the string.
-    char *output = (char *) mysbrk(length + 2);
+    if (*p != '\0') {
+        if ((p = parseZoneName(p)) == NULL) {
+            return -1;
+        }
 
-    char *temp = output;
+        if (*p != '\0' && *p != ',') {
+            if ((p = parseZoneTime(p, &offset)) == NULL) {
+                return -1;
+            }
+            zone->dstOffset = -offset;
+        }
 
-    int limit = length - lengthOf; //calculate the number of required whitespace characters
+        if (*p == '\0') { //no rule, so the rule of the United States is used
+            parseZoneRule("M3.2.0", &zone->start);
+            parseZoneRule("M11.1.0", &zone->end);
+        } else if (*p != ',' || (p = parseZoneRule(p + 1, &zone->start)) == NULL || *p != ','
+                || (p = parseZoneRule(p + 1, &zone->end)) == NULL || *p != '\0') {
+            return -1;
+        }
 
-    int i;
-    for (i = 0; i <= limit; i++) {
-        *temp++ = ' '; //append the whitespace characters
+        zone->hasDst = 1;
     }
-    strcopy(temp, str, lengthOf);
 
-    printOut(output);
+    zone->hasRule = 1;
+    return 0;
 }
 
 /**
- * This function reads the file stat(s) and print out the file stat(s).
- * It calls the wrapper functions of system calls such as write or stat.
+ * This function reads the big-endian signed integer of the TZif file.
  *
- * @param fileName the name of the target file (or directory)
+ * @param p the pointer to the integer
+ * @param bytes the size of the integer (4 or 8)
+ * @return the integer
+ */
+long readBigEndian(const unsigned char *p, int bytes) {
+    unsigned long value = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | p[i];
+    }
+
+    return (bytes == 4) ? (long) (int) value : (long) value;
+}
+
+/**
+ * This function calculates the size of the data block after the header of the TZif file.
+ *
+ * @param header the header of the TZif file
+ * @param timeSize the size of the transition times (4 for the version 1 block, 8 for the version 2+ block)
+ * @return the size of the data block
+ */
+long zoneBlockSize(const unsigned char *header, long timeSize) {
+    long isutcnt = readBigEndian(header + 20, 4) & 0xffffffffL;
+    long isstdcnt = readBigEndian(header + 24, 4) & 0xffffffffL;
+    long leapcnt = readBigEndian(header + 28, 4) & 0xffffffffL;
+    long timecnt = readBigEndian(header + 32, 4) & 0xffffffffL;
+    long typecnt = readBigEndian(header + 36, 4) & 0xffffffffL;
+    long charcnt = readBigEndian(header + 40, 4) & 0xffffffffL;
+
+    return timecnt * timeSize + timecnt + typecnt * 6 + charcnt + leapcnt * (timeSize + 4) + isstdcnt + isutcnt;
+}
+
+/**
+ * This function parses the TZif file, which stores the transitions of the time zone and the local time types.
+ * The 64-bit data block of the version 2+ file is used, and its footer gives the rule after the last transition.
+ * The time zones with leap seconds are not parsed, so they use the localtime().
+ *
+ * @reference https://www.rfc-editor.org/rfc/rfc8536
+ *
+ * @param zone the time zone to store the transitions
+ * @param data the content of the TZif file
+ * @param size the size of the file
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int parseZoneData(struct timeZone *zone, unsigned char *data, long size) {
+    unsigned char *header = data;
+    unsigned char *end = data + size;
+    long timeSize = 4;
+
+    if (size < TZIF_HEADER_SIZE || data[0] != 'T' || data[1] != 'Z' || data[2] != 'i' || data[3] != 'f') {
+        return -1;
+    }
+
+    if (data[4] >= '2') { //skip the 32-bit data block of the version 1
+        header = data + TZIF_HEADER_SIZE + zoneBlockSize(data, 4);
+        timeSize = 8;
+
+        if (header + TZIF_HEADER_SIZE > end || header[0] != 'T' || header[1] != 'Z' || header[2] != 'i' || header[3] != 'f') {
+            return -1;
+        }
+    }
+
+    long leapcnt = readBigEndian(header + 28, 4);
+    long timecnt = readBigEndian(header + 32, 4) & 0xffffffffL;
+    long typecnt = readBigEndian(header + 36, 4) & 0xffffffffL;
+    unsigned char *p = header + TZIF_HEADER_SIZE;
+
+    if (p + zoneBlockSize(header, timeSize) > end || leapcnt != 0 || typecnt == 0) {
+        return -1;
+    }
+
+    zone->transitions = (long *) allocateMemory(timecnt * sizeof(long));
+    zone->types = (unsigned char *) allocateMemory(timecnt);
+    zone->typeOffsets = (long *) allocateMemory(typecnt * sizeof(long));
+
+    for (long i = 0; i < timecnt; i++) {
+        zone->transitions[i] = readBigEndian(p + i * timeSize, timeSize);
+    }
+    p += timecnt * timeSize;
+
+    for (long i = 0; i < timecnt; i++) {
+        if ((zone->types[i] = p[i]) >= typecnt) {
+            return -1;
+        }
+    }
+    p += timecnt;
+
+    for (long i = 0; i < typecnt; i++) { //each local time type is utoff(4), isdst(1) and desigidx(1)
+        zone->typeOffsets[i] = readBigEndian(p + i * 6, 4);
+    }
+
+    p = header + TZIF_HEADER_SIZE + zoneBlockSize(header, timeSize);
+    zone->count = timecnt;
+    zone->typeCount = typecnt;
+    zone->hasRule = 0;
+
+    if (timeSize == 8 && p < end && *p == '\n') { //the footer is the POSIX TZ string between two new lines
+        unsigned char *footer = p + 1;
+
+        for (p = footer; p < end && *p != '\n'; p++);
+
+        if (p < end && p > footer) {
+            *p = '\0';
+
+            if (parsePosixZone(zone, (char *) footer) < 0) {
+                zone->hasRule = 0;
+            }
+        }
+    }
+
+    zone->loaded = 1;
+    return 0;
+}
+
+/**
+ * This function reads and parses the TZif file with the given path.
+ *
+ * @param zone the time zone to store the transitions
+ * @param path the path of the TZif file
+ * @return On success, returns 0. Otherwise, returns -1.
+ */
+int loadZoneFile(struct timeZone *zone, const char *path) {
+    struct stat statBuffer;
+    long fd = openFile(path);
+    long length = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (checkFdStat(fd, &statBuffer) < 0 || statBuffer.st_size < TZIF_HEADER_SIZE || statBuffer.st_size > MAX_ZONE_FILE) {
+        closeFile(fd);
+        return -1;
+    }
+
+    char *data = (char *) allocateMemory(statBuffer.st_size);
+
+    while (length < statBuffer.st_size) {
+        long nread = readFile(fd, data + length, statBuffer.st_size - length);
+
+        if (nread <= 0) {
+            break;
+        }
+
+        length += nread;
+    }
+
+    closeFile(fd);
+
+    return parseZoneData(zone, (unsigned char *) data, length);
+}
+
+/**
+ * This function empties the given time zone, so that the localtime() is used until the time zone is loaded.
+ *
+ * @param zone the time zone
+ */
+void initZone(struct timeZone *zone) {
+    zone->loaded = 0;
+    zone->count = 0;
+    zone->typeCount = 0;
+    zone->hasRule = 0;
+    zone->hasDst = 0;
+    zone->cacheFrom = 1; //the cache is empty
+    zone->cacheUntil = 0;
+}
+
+/**
+ * This function loads the local time zone once, just like the tzset() of the libc.
+ * If the TZ environment variable is not set, the /etc/localtime is loaded. Otherwise, the TZ is the path of the TZif file
+ * (or the name of the file in the zoneinfo directory), or the POSIX TZ string. An empty TZ means UTC.
+ * If the time zone could not be loaded, the localtime() is used.
+ *
+ * @param envp the environment variables
+ */
+void loadLocalZone(char **envp) {
+    char *tz = NULL;
+
+    for (; envp != NULL && *envp != NULL; envp++) {
+        if ((*envp)[0] == 'T' && (*envp)[1] == 'Z' && (*envp)[2] == '=') {
+            tz = *envp + 3;
+        }
+    }
+
+    initZone(&localZone);
+
+    if (tz == NULL) {
+        loadZoneFile(&localZone, LOCAL_ZONE_FILE);
+        return;
+    }
+
+    if (*tz == ':') {
+        tz += 1;
+    }
+
+    if (*tz == '\0') {
+        tz = "UTC0";
+    } else if (loadZoneFile(&localZone, (*tz == '/') ? tz : strconcat(ZONE_DIRECTORY, tz)) == 0) {
+        return;
+    }
+
+    initZone(&localZone);
+
+    if (parsePosixZone(&localZone, tz) == 0) {
+        localZone.loaded = 1;
+    }
+}
+
+/**
+ * This function finds the offset from UTC of the DST rule of the time zone, at the given UTC time.
+ * The transitions of the previous, the current and the next year are checked, so the range of the offset is cached as well.
+ *
+ * @param zone the time zone
+ * @param t the UTC time
+ * @param from the UTC time of the last transition of the TZif file (the rule is used after it)
+ * @param offset the offset after the last transition of the TZif file, until the first transition of the rule
+ * @return the offset from UTC in seconds
+ */
+long ruleOffset(struct timeZone *zone, long t, long from, long offset) {
+    long until = LONG_MAX;
+
+    if (zone->hasDst) {
+        long year;
+        int month, day;
+
+        civilFromDays(floorDivide(t + zone->stdOffset, 86400), &year, &month, &day);
+
+        for (long y = year - 1; y <= year + 1; y++) {
+            long start = ruleTime(y, &zone->start) - zone->stdOffset; //the start is given in the standard time
+            long end = ruleTime(y, &zone->end) - zone->dstOffset;     //the end is given in the daylight saving time
+
+            if (start <= t && start >= from) {
+                from = start;
+                offset = zone->dstOffset;
+            }
+            if (end <= t && end >= from) {
+                from = end;
+                offset = zone->stdOffset;
+            }
+            if (start > t && start < until) until = start;
+            if (end > t && end < until) until = end;
+        }
+    }
+
+    zone->cacheFrom = from;
+    zone->cacheUntil = until;
+    zone->cacheOffset = offset;
+    return offset;
+}
+
+/**
+ * This function finds the offset from UTC of the local time at the given UTC time.
+ * The transitions are searched with the binary search, unless the time is in the range of the cached offset.
+ *
+ * @param zone the time zone
+ * @param t the UTC time
+ * @return the offset from UTC in seconds (east of UTC is positive)
+ */
+long zoneOffset(struct timeZone *zone, long t) {
+    if (t >= zone->cacheFrom && t < zone->cacheUntil) {
+        return zone->cacheOffset;
+    }
+
+    long from = LONG_MIN, until = LONG_MAX, offset;
+
+    if (zone->count == 0 || t >= zone->transitions[zone->count - 1]) {
+        if (zone->count > 0) {
+            from = zone->transitions[zone->count - 1];
+            offset = zone->typeOffsets[zone->types[zone->count - 1]];
+        } else {
+            offset = (zone->typeCount > 0) ? zone->typeOffsets[0] : zone->stdOffset;
+        }
+
+        if (zone->hasRule) {
+            return ruleOffset(zone, t, from, offset);
+        }
+    } else if (t < zone->transitions[0]) { //the first local time type is used before the first transition
+        until = zone->transitions[0];
+        offset = zone->typeOffsets[0];
+    } else {
+        long low = 0, high = zone->count - 1; //transitions[low] <= t < transitions[high]
+
+        while (high - low > 1) {
+            long mid = low + (high - low) / 2;
+
+            if (zone->transitions[mid] <= t) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+
+        from = zone->transitions[low];
+        until = zone->transitions[high];
+        offset = zone->typeOffsets[zone->types[low]];
+    }
+
+    zone->cacheFrom = from;
+    zone->cacheUntil = until;
+    zone->cacheOffset = offset;
+    return offset;
+}
+
+/**
+ * This function converts the given UTC time to the local time, as the number of seconds since the local 1970-01-01.
+ * If the time zone could not be loaded, the localtime() converts it (the freestanding build has no localtime(), so the UTC is used).
+ *
+ * @param t the UTC time
+ * @return the local time in seconds
+ */
+long localSeconds(long t) {
+    if (localZone.loaded) {
+        return t + zoneOffset(&localZone, t);
+    }
+
+#ifdef FREESTANDING
+    return t;
+#else
+    time_t modTime = t;
+    struct tm *modT = localtime(&modTime);
+
+    return daysFromCivil(modT->tm_year + 1900, modT->tm_mon + 1, modT->tm_mday) * 86400
+        + modT->tm_hour * 3600 + modT->tm_min * 60 + modT->tm_sec;
+#endif
+}
+
+/**
+ * This function finds the local year of the given time, as the number of years since 1900 (just like the tm_year).
+ *
+ * @param t the UTC time
+ * @return the number of years since 1900
+ */
+int localYear(long t) {
+    long year;
+    int month, day;
+
+    civilFromDays(floorDivide(localSeconds(t), 86400), &year, &month, &day);
+    return (int) (year - 1900);
+}
+
+/**
+ * This function formats the last modified time of the file, just like the ls command
+ * (the day, the month, and the time for the files of this year, or the year for the other files).
+ * The last formatted minute is cached, and the day and the month are reused for the other minutes of the same day,
+ * so the files with nearby modified times are formatted by copying the cache.
+ *
+ * @param str the pointer points to the string (at least 13 bytes)
+ * @param modTime the last modified time
+ * @return the pointer to the end of the string
+ */
+char *formatModTime(char *str, time_t modTime) {
+    long minute = floorDivide(localSeconds(modTime), 60);
+
+    if (minute != cachedMinute) {
+        long day = floorDivide(minute, 1440);
+
+        if (day != cachedDay) {
+            long year;
+            int month, mday;
+
+            civilFromDays(day, &year, &month, &mday);
+
+            if (mday < 10) {
+                timeCache[0] = ' ';
+                timeCache[1] = (char) (mday + '0');
+            } else {
+                formatDecimal(timeCache, 2, mday);
+            }
+
+            timeCache[2] = ' ';
+            convertMonthToStr(month - 1, timeCache + 3); //convert the type of the month from number to string
+            timeCache[6] = ' ';
+
+            cachedThisYear = (year - 1900 == currentYear);
+
+            if (!cachedThisYear) {
+                timeCache[7] = ' ';
+                formatDecimal(timeCache + 8, 4, year);
+            }
+
+            cachedDay = day;
+        }
+
+        if (cachedThisYear) { //the hour and the minute always have two digits
+            long minuteOfDay = minute - cachedDay * 1440;
+
+            formatDecimal(timeCache + 7, 2, minuteOfDay / 60);
+            timeCache[9] = ':';
+            formatDecimal(timeCache + 10, 2, minuteOfDay % 60);
+        }
+
+        timeCache[12] = ' ';
+        cachedMinute = minute;
+    }
+
+    strcopy(str, timeCache, 13);
+    return str + 13;
+}
+
+/**
+ * This function makes a new array with the given capacity, and copies the elements of the old array to it.
+ * The old array is released with the other allocations of the operand.
+ *
+ * @param old the old array
+ * @param used the number of bytes of the old array
+ * @param size the number of bytes of the new array
+ * @return the new array
+ */
+void *growArray(void *old, long used, long size) {
+    char *grown = (char *) allocateMemory(size);
+
+    if (old != NULL) {
+        strcopy(grown, (char *) old, (int) used);
+    }
+
+    return grown;
+}
+
+/**
+ * This function empties the given entry table, for the next operand.
+ *
+ * @param t the entry table
+ */
+void initEntryTable(struct entryTable *t) {
+    t->mode = NULL;
+    t->link = NULL;
+    t->uid = NULL;
+    t->gid = NULL;
+    t->size = NULL;
+    t->modTime = NULL;
+    t->changeTime = NULL;
+    t->inode = NULL;
+    t->isDir = NULL;
+    t->nameOffset = NULL;
+    t->names = NULL;
+    t->count = 0;
+    t->capacity = 0;
+    t->nameLength = 0;
+    t->nameCapacity = 0;
+    t->maxLink = 0;
+    t->maxUid = 0;
+    t->maxGid = 0;
+    t->maxSize = 0;
+    t->maxInode = 0;
+}
+
+/**
+ * This function appends the name of the given file to the entry table, without its file stat.
+ * The arrays and the name pool double when they are full.
+ *
+ * @param t the entry table
+ * @param fileName the name of the file
+ * @return the slot of the new entry
+ */
+long appendEntry(struct entryTable *t, char *fileName) {
+    long length = strlength(fileName) + 1;
+    long i = t->count;
+
+    if (i == t->capacity) {
+        long capacity = (t->capacity == 0) ? INITIAL_ENTRIES : t->capacity * 2;
+
+        t->mode = (mode_t *) growArray(t->mode, i * sizeof(mode_t), capacity * sizeof(mode_t));
+        t->link = (unsigned long *) growArray(t->link, i * sizeof(unsigned long), capacity * sizeof(unsigned long));
+        t->uid = (uid_t *) growArray(t->uid, i * sizeof(uid_t), capacity * sizeof(uid_t));
+        t->gid = (gid_t *) growArray(t->gid, i * sizeof(gid_t), capacity * sizeof(gid_t));
+        t->size = (unsigned long *) growArray(t->size, i * sizeof(unsigned long), capacity * sizeof(unsigned long));
+        t->modTime = (time_t *) growArray(t->modTime, i * sizeof(time_t), capacity * sizeof(time_t));
+        t->changeTime = (time_t *) growArray(t->changeTime, i * sizeof(time_t), capacity * sizeof(time_t));
+        t->inode = (unsigned long *) growArray(t->inode, i * sizeof(unsigned long), capacity * sizeof(unsigned long));
+        t->isDir = (char *) growArray(t->isDir, i, capacity);
+        t->nameOffset = (unsigned int *) growArray(t->nameOffset, i * sizeof(unsigned int), capacity * sizeof(unsigned int));
+        t->capacity = capacity;
+    }
+
+    if (t->nameLength + length > t->nameCapacity) {
+        long capacity = (t->nameCapacity == 0) ? INITIAL_NAME_POOL : t->nameCapacity * 2;
+
+        while (capacity < t->nameLength + length) {
+            capacity *= 2;
+        }
+
+        t->names = (char *) growArray(t->names, t->nameLength, capacity);
+        t->nameCapacity = capacity;
+    }
+
+    t->mode[i] = 0;
+    t->link[i] = 0;
+    t->uid[i] = 0;
+    t->gid[i] = 0;
+    t->size[i] = 0;
+    t->modTime[i] = 0;
+    t->changeTime[i] = 0;
+    t->inode[i] = 0;
+    t->isDir[i] = 0;
+    t->nameOffset[i] = (unsigned int) t->nameLength;
+    strcopy(t->names + t->nameLength, fileName, length); //copy the file name with the terminator
+    t->nameLength += length;
+
+    t->count += 1;
+    return i;
+}
+
+/**
+ * This function stores the file stat in the given slot of the entry table.
+ *
+ * @param t the entry table
+ * @param i the slot of the entry
+ * @param st the file stat (only the fields of the output are filled)
+ */
+void setEntryStat(struct entryTable *t, long i, struct linux_statx *st) {
+    t->mode[i] = st->stx_mode;
+    t->link[i] = st->stx_nlink;
+    t->uid[i] = st->stx_uid;
+    t->gid[i] = st->stx_gid;
+    t->size[i] = st->stx_size;
+    t->modTime[i] = st->stx_mtime.tv_sec;
+    t->changeTime[i] = st->stx_ctime.tv_sec;
+    t->inode[i] = st->stx_ino;
+}
+
+/**
+ * This function updates the maximum of each column with the given entry, to find the widths of the columns.
+ *
+ * @param t the entry table
+ * @param i the slot of the entry
+ */
+void updateColumnWidths(struct entryTable *t, long i) {
+    if (t->link[i] > t->maxLink) t->maxLink = t->link[i];
+    if (t->uid[i] > t->maxUid) t->maxUid = t->uid[i];
+    if (t->gid[i] > t->maxGid) t->maxGid = t->gid[i];
+    if (t->size[i] > t->maxSize) t->maxSize = t->size[i];
+    if (t->inode[i] > t->maxInode) t->maxInode = t->inode[i];
+}
+
+/**
+ * This function appends the raw file stat of the given file to the entry table.
+ *
+ * @param t the entry table
+ * @param fileName the name of the file
+ * @param st the file stat (only the fields of the output are filled)
+ */
+void addEntry(struct entryTable *t, char *fileName, struct linux_statx *st) {
+    long i = appendEntry(t, fileName);
+
+    setEntryStat(t, i, st);
+    updateColumnWidths(t, i);
+}
+
+/**
+ * This function checks the file permission of the particular file and convert the file permission to the string.
+ *
+ * @param fp the pointer that points to the character array
+ * @param mode the variable that shows the file permission of the specific file.
+ */
+void checkFilePermission(char *fp, mode_t mode) {
+    if (mode & S_IFDIR) {
+        fp[0] = 'd';
+    } else {
+        fp[0] = '-';
+    }
+
+    if (mode & S_IRUSR) {
+        fp[1] = 'r';
+    } else {
+        fp[1] = '-';
+    }
+
+    if (mode & S_IWUSR) {
+        fp[2] = 'w';
+    } else {
+        fp[2] = '-';
+    }
+
+    if (mode & S_IXUSR) {
+        fp[3] = 'x';
+    } else {
+        fp[3] = '-';
+    }
+
+    if (mode & S_IRGRP) {
+        fp[4] = 'r';
+    } else {
+        fp[4] = '-';
+    }
+
+    if (mode & S_IWGRP) {
+        fp[5] = 'w';
+    } else {
+        fp[5] = '-';
+    }
+
+    if (mode & S_IXGRP) {
+        fp[6] = 'x';
+    } else {
+        fp[6] = '-';
+    }
+
+    if (mode & S_IROTH) {
+        fp[7] = 'r';
+    } else {
+        fp[7] = '-';
+    }
+
+    if (mode & S_IWOTH) {
+        fp[8] = 'w';
+    } else {
+        fp[8] = '-';
+    }
+
+    if (mode & S_IXOTH) {
+        fp[9] = 'x';
+    } else {
+        fp[9] = '-';
+    }
+
+    fp[10] = ' ';
+    fp[11] = '\0';
+}
+
+/**
+ * This function is a wrapper function of the statx system call, which reads only the requested fields of the file stat.
+ * The file name is looked up relative to the opened directory, so the kernel does not walk the whole path again.
+ * If the kernel does not support the statx syscall, the newfstatat syscall reads the whole file stat instead.
+ *
+ * @param dirFd the file descriptor of the directory that contains the file (or AT_FDCWD)
+ * @param fileName the name of the target file
+ * @param flags 0 to follow the symbolic links (just like the stat syscall), or AT_SYMLINK_NOFOLLOW
+ * @param mask the request mask (i.e. STATX_SIZE)
+ * @param statxBuffer the buffer to store the file stat
+ * @return On success, zero will be returned. Otherwise, -errno will be returned.
+ */
+int readFileStat(long dirFd, char *fileName, int flags, unsigned int mask, struct linux_statx *statxBuffer) {
+    long ret = ENOSYS_ERROR;
+
+    __atomic_fetch_add(&statCalls, 1, __ATOMIC_RELAXED); //the workers of the parallel stat also count their syscalls
+
+    if (!statxMissing) {
+        ret = syscall5(STATX_SYSCALL, dirFd, (long) fileName, flags | statxFlags, mask, (long) statxBuffer);
+
+        if (ret != ENOSYS_ERROR) {
+            return ret;
+        }
+
+        statxMissing = 1;
+    }
+
+    struct stat statBuffer;
+
+    ret = syscall4(NEWFSTATAT_SYSCALL, dirFd, (long) fileName, (long) &statBuffer, flags);
+
+    statxBuffer->stx_mode = statBuffer.st_mode;
+    statxBuffer->stx_nlink = statBuffer.st_nlink;
+    statxBuffer->stx_uid = statBuffer.st_uid;
+    statxBuffer->stx_gid = statBuffer.st_gid;
+    statxBuffer->stx_size = statBuffer.st_size;
+    statxBuffer->stx_mtime.tv_sec = statBuffer.st_mtime;
+    statxBuffer->stx_ctime.tv_sec = statBuffer.st_ctime;
+    statxBuffer->stx_ino = statBuffer.st_ino;
+
+    return ret;
+}
+
+/**
+ * This function returns the statx fields that are stored in the cache file of the listed directory (the -C option).
+ * If the output only has the fields of the directory entries, the files are not stat-ed, so the cache file only has the
+ * inode numbers and the types of the directory entries (the types are complete only if they were printed out), and it keeps
+ * the dangling links, so it is never mixed with the cache files of the file stats.
+ *
+ * @return the statx fields of the cached entries
+ */
+unsigned int cacheMask() {
+    if (direntOnly) {
+        return CACHE_DIRENT | ((outputFields & FIELD_TYPE) ? STATX_TYPE : 0);
+    }
+
+    return statxMask;
+}
+
+/**
+ * This function returns the size of the cache file of the directory with the given number of entries.
+ *
+ * @param count the number of entries
+ * @param nameLength the number of bytes of the name pool
+ * @return the size of the cache file
+ */
+long cacheSize(long count, long nameLength) {
+    return (long) sizeof(struct cacheHeader) + count * (long) (4 * sizeof(unsigned long) + sizeof(time_t)
+        + sizeof(mode_t) + sizeof(uid_t) + sizeof(gid_t) + sizeof(unsigned int) + 1) + nameLength;
+}
+
+/**
+ * This function points the columns of the given entry table to the cache file at the given address.
+ * The columns follow the header in the order of their alignment (the 8-byte columns first), so they need no padding.
+ *
+ * @param t the entry table
+ * @param base the address of the cache file
+ * @param count the number of entries
+ * @param nameLength the number of bytes of the name pool
+ */
+void cacheLayout(struct entryTable *t, char *base, long count, long nameLength) {
+    char *p = base + sizeof(struct cacheHeader);
+
+    t->link = (unsigned long *) p;
+    p += count * sizeof(unsigned long);
+    t->size = (unsigned long *) p;
+    p += count * sizeof(unsigned long);
+    t->inode = (unsigned long *) p;
+    p += count * sizeof(unsigned long);
+    t->modTime = (time_t *) p;
+    p += count * sizeof(time_t);
+    t->changeTime = (time_t *) p;
+    p += count * sizeof(time_t);
+    t->mode = (mode_t *) p;
+    p += count * sizeof(mode_t);
+    t->uid = (uid_t *) p;
+    p += count * sizeof(uid_t);
+    t->gid = (gid_t *) p;
+    p += count * sizeof(gid_t);
+    t->nameOffset = (unsigned int *) p;
+    p += count * sizeof(unsigned int);
+    t->isDir = p;
+    p += count;
+    t->names = p;
+
+    t->count = count;
+    t->capacity = count; //the columns are copied to the heap if an entry is ever appended
+    t->nameLength = nameLength;
+    t->nameCapacity = nameLength;
+}
+
+/**
+ * This function builds the path of the cache file of the given directory, which is named after its device and inode number
+ * (i.e. "cache/259.1.1234"), so the cache file still matches after the directory is renamed, or listed with another path.
+ *
+ * @param dirStat the file stat of the directory
+ * @return the path of the cache file (allocated from the heap)
+ */
+char *cachePath(struct linux_statx *dirStat) {
+    char num[21];
+    char *path = strconcat(cacheDirectory, "/");
+
+    path = strconcat(path, formatNumber(dirStat->stx_dev_major, num));
+    path = strconcat(path, ".");
+    path = strconcat(path, formatNumber(dirStat->stx_dev_minor, num));
+    path = strconcat(path, ".");
+    return strconcat(path, formatNumber(dirStat->stx_ino, num));
+}
+
+/**
+ * This function unmaps the cache file of the listed directory, after its entries are printed out.
+ */
+void releaseCache() {
+    if (cacheMap != NULL) {
+        unmapMemory((char *) cacheMap, cacheMapSize);
+        cacheMap = NULL;
+    }
+
+    cacheIndex = NULL; //the hash table is released with the heap of the operand
+}
+
+/**
+ * This function maps the cache file of the given directory, and checks that it is a complete cache file of that directory.
+ * The columns of the cachedEntries point to the mapped file.
+ *
+ * @param dirStat the file stat of the directory
+ * @return the header of the mapped cache file, or NULL if there is no valid cache file
+ */
+struct cacheHeader *mapCache(struct linux_statx *dirStat) {
+    int fd = openFile(cachePath(dirStat));
+    struct stat statBuffer;
+    long map = -1;
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (checkFdStat(fd, &statBuffer) == 0 && statBuffer.st_size >= (long) sizeof(struct cacheHeader)) {
+        map = mapFile(fd, statBuffer.st_size);
+    }
+
+    closeFile(fd); //the mapping stays valid after the file is closed (or replaced)
+
+    if (map < 0) {
+        return NULL;
+    }
+
+    struct cacheHeader *h = (struct cacheHeader *) map;
+
+    cacheMap = h;
+    cacheMapSize = statBuffer.st_size;
+
+    if (h->magic != CACHE_MAGIC || h->devMajor != dirStat->stx_dev_major || h->devMinor != dirStat->stx_dev_minor
+        || h->ino != dirStat->stx_ino || h->count < 0 || h->nameLength < 0 || h->count > cacheMapSize || h->nameLength > cacheMapSize
+        || cacheSize(h->count, h->nameLength) != cacheMapSize) {
+        releaseCache();
+        return NULL;
+    }
+
+    cacheLayout(&cachedEntries, (char *) h, h->count, h->nameLength);
+
+    for (long i = 0; i < h->count; i++) { //a damaged cache file must not point outside of the name pool
+        if (cachedEntries.nameOffset[i] >= (unsigned long) h->nameLength) {
+            releaseCache();
+            return NULL;
+        }
+    }
+
+    if (h->nameLength > 0 && cachedEntries.names[h->nameLength - 1] != '\0') {
+        releaseCache();
+        return NULL;
+    }
+
+    cachedEntries.maxLink = h->maxLink;
+    cachedEntries.maxUid = h->maxUid;
+    cachedEntries.maxGid = h->maxGid;
+    cachedEntries.maxSize = h->maxSize;
+    cachedEntries.maxInode = h->maxInode;
+
+    return h;
+}
+
+/**
+ * This function writes the entry table of the listed directory to its cache file. The file is written to a temporary
+ * file first, and then renamed over the old cache file, so another myls never maps a partial cache file.
+ * The cache is only an optimisation, so the errors are ignored.
+ *
+ * @param dirStat the file stat of the directory (before it was read)
+ * @param snapshot the time just before the directory was read
+ * @param verified the time when the oldest file stats of the entry table were read
+ */
+void saveCache(struct linux_statx *dirStat, long snapshot, long verified) {
+    struct arenaMark mark = markArena(&heap); //the image of the file is released after writing it
+    long count = entries.count;
+    long size = cacheSize(count, entries.nameLength);
+    char *path = cachePath(dirStat);
+    char num[21];
+    //each myls writes its own temporary file, so two runs that save the same directory at once never mix their writes
+    char *temp = strconcat(strconcat(strconcat(path, "."), formatNumber(getProcessId(), num)), ".tmp");
+    char *image = (char *) allocateMemory(size);
+    struct cacheHeader *h = (struct cacheHeader *) image;
+    struct entryTable out;
+
+    h->magic = CACHE_MAGIC;
+    h->mask = cacheMask();
+    h->devMajor = dirStat->stx_dev_major;
+    h->devMinor = dirStat->stx_dev_minor;
+    h->pad = 0;
+    h->ino = dirStat->stx_ino;
+    h->mtime = dirStat->stx_mtime;
+    h->ctime = dirStat->stx_ctime;
+    h->snapshot = snapshot;
+    h->verified = verified;
+    h->count = count;
+    h->nameLength = entries.nameLength;
+    h->maxLink = entries.maxLink;
+    h->maxUid = entries.maxUid;
+    h->maxGid = entries.maxGid;
+    h->maxSize = entries.maxSize;
+    h->maxInode = entries.maxInode;
+
+    cacheLayout(&out, image, count, entries.nameLength);
+    strcopy((char *) out.link, (char *) entries.link, count * sizeof(unsigned long));
+    strcopy((char *) out.size, (char *) entries.size, count * sizeof(unsigned long));
+    strcopy((char *) out.inode, (char *) entries.inode, count * sizeof(unsigned long));
+    strcopy((char *) out.modTime, (char *) entries.modTime, count * sizeof(time_t));
+    strcopy((char *) out.changeTime, (char *) entries.changeTime, count * sizeof(time_t));
+    strcopy((char *) out.mode, (char *) entries.mode, count * sizeof(mode_t));
+    strcopy((char *) out.uid, (char *) entries.uid, count * sizeof(uid_t));
+    strcopy((char *) out.gid, (char *) entries.gid, count * sizeof(gid_t));
+    strcopy((char *) out.nameOffset, (char *) entries.nameOffset, count * sizeof(unsigned int));
+    strcopy(out.isDir, entries.isDir, count);
+    strcopy(out.names, entries.names, entries.nameLength);
+
+    int fd = createFile(temp);
+
+    if (fd >= 0) {
+        long done = 0;
+
+        while (done < size) {
+            long written = writeFile(fd, image + done, size - done);
+
+            if (written <= 0) {
+                break;
+            }
+            done += written;
+        }
+
+        closeFile(fd);
+
+        if (done == size && renameFile(temp, path) == 0) {
+            cacheWrites += 1;
+        } else {
+            removeFile(temp); //the partial file is not left behind
+        }
+    }
+
+    resetArena(&heap, mark);
+}
+
+/**
+ * This function checks if the entry with the given last status change is hot, which means that it could still be changing
+ * (i.e. a log file), so it is stat-ed again instead of being served from the cache file.
+ *
+ * @param changeTime the last status change of the entry
+ * @return 1 if the entry changed in the last CACHE_HOT_SECONDS seconds, or 0
+ */
+char isHotEntry(time_t changeTime) {
+    return changeTime >= currentTime - CACHE_HOT_SECONDS;
+}
+
+/**
+ * This function returns the FNV-1a hash of the given name, for the hash table of the cached names.
+ *
+ * @param name the name of the entry
+ * @return the hash of the name
+ */
+unsigned long hashName(const char *name) {
+    unsigned long hash = 14695981039346656037UL;
+
+    while (*name != '\0') {
+        hash = (hash ^ (unsigned char) *name++) * 1099511628211UL;
+    }
+
+    return hash;
+}
+
+/**
+ * This function builds the hash table of the names of the mapped cache file (with the linear probing),
+ * so that the entries of a changed directory could find their cached file stats.
+ */
+void indexCache() {
+    long size = 2;
+
+    while (size < cachedEntries.count * 2) {
+        size *= 2;
+    }
+
+    cacheIndex = (unsigned int *) allocateMemory(size * sizeof(unsigned int));
+    cacheIndexMask = size - 1;
+
+    for (long i = 0; i < size; i++) {
+        cacheIndex[i] = 0;
+    }
+
+    for (long i = 0; i < cachedEntries.count; i++) {
+        long h = (long) (hashName(cachedEntries.names + cachedEntries.nameOffset[i]) & cacheIndexMask);
+
+        while (cacheIndex[h] != 0) {
+            h = (h + 1) & cacheIndexMask;
+        }
+        cacheIndex[h] = (unsigned int) (i + 1);
+    }
+}
+
+/**
+ * This function finds the cached entry with the given name.
+ *
+ * @param name the name of the entry
+ * @return the slot of the cached entry, or -1 if the name is not in the cache file
+ */
+long findCachedEntry(const char *name) {
+    long h = (long) (hashName(name) & cacheIndexMask);
+
+    for (; cacheIndex[h] != 0; h = (h + 1) & cacheIndexMask) {
+        long slot = cacheIndex[h] - 1;
+
+        if (strCompare(cachedEntries.names + cachedEntries.nameOffset[slot], name) == 0) {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * This function copies the cached file stats of the entries of a changed directory, which have the same name and
+ * the same inode number as in the cache file and are not hot, and collects the other slots to stat them.
+ *
+ * @param first the first slot of the directory in the entry table
+ * @param fresh the array to store the slots that should be stat-ed
+ * @return the number of the slots that should be stat-ed
+ */
+long reuseCachedEntries(long first, unsigned int *fresh) {
+    long count = 0;
+
+    for (long i = first; i < entries.count; i++) {
+        long j = findCachedEntry(entries.names + entries.nameOffset[i]);
+
+        if (j < 0 || cachedEntries.inode[j] != entries.inode[i] || isHotEntry(cachedEntries.changeTime[j])) {
+            fresh[count] = (unsigned int) i;
+            count += 1;
+            continue;
+        }
+
+        entries.mode[i] = cachedEntries.mode[j];
+        entries.link[i] = cachedEntries.link[j];
+        entries.uid[i] = cachedEntries.uid[j];
+        entries.gid[i] = cachedEntries.gid[j];
+        entries.size[i] = cachedEntries.size[j];
+        entries.modTime[i] = cachedEntries.modTime[j];
+        entries.changeTime[i] = cachedEntries.changeTime[j];
+        cacheReused += 1;
+    }
+
+    return count;
+}
+
+/**
+ * This function stats the hot entries of a directory that was listed from its cache file again, and rewrites
+ * the cache file if any of them has changed (or has been removed).
+ *
+ * @param fileName the path of the directory
+ * @param dirStat the file stat of the directory
+ */
+void refreshHotEntries(char *fileName, struct linux_statx *dirStat) {
+    long count = entries.count;
+    long hotCount = 0;
+
+    if (!(cacheMap->mask & STATX_CTIME)) { //the entries of the directory entry output are never stat-ed
+        return;
+    }
+
+    for (long i = 0; i < count; i++) {
+        hotCount += isHotEntry(entries.changeTime[i]);
+    }
+
+    if (hotCount == 0) { //the usual case for the static directories, which needs no memory
+        return;
+    }
+
+    unsigned int *hot = (unsigned int *) allocateMemory(hotCount * sizeof(unsigned int));
+
+    for (long i = 0, k = 0; i < count; i++) {
+        if (isHotEntry(entries.changeTime[i])) {
+            hot[k] = (unsigned int) i;
+            k += 1;
+        }
+    }
+
+    time_t *before = (time_t *) allocateMemory(hotCount * sizeof(time_t));
+    long snapshot = getCurrentTime();
+    int fd = openDirectory(fileName);
+    char changed = 0;
+
+    if (fd < 0) {
+        return;
+    }
+
+    for (long k = 0; k < hotCount; k++) {
+        before[k] = entries.changeTime[hot[k]];
+    }
+
+    entries.maxLink = 0; //the widths are calculated again, since the hot entries could have shrunk
+    entries.maxUid = 0;
+    entries.maxGid = 0;
+    entries.maxSize = 0;
+    entries.maxInode = 0;
+
+    statEntries(fd, 0, hot, hotCount);
+    closeFile(fd);
+
+    changed = (entries.count != count);
+
+    for (long k = 0; k < hotCount && !changed; k++) {
+        changed = (entries.changeTime[hot[k]] != before[k]);
+    }
+
+    if (changed) {
+        saveCache(dirStat, snapshot, cacheMap->verified); //the entries that were not hot keep their old file stats
+    }
+}
+
+/**
+ * This function lists the given directory from its cache file (the -C option), if the directory has not changed since
+ * the cache file was written: the same device and inode number, the same last modified time and last status change,
+ * and those times are older than the snapshot of the cache file (a change in the same second could keep the times).
+ * Then the entry table points to the mapped cache file, so the directory is listed with one stat and one mmap,
+ * and only the hot entries are stat-ed again. If the directory has changed, the mapped cache file is indexed,
+ * so that the entries that are still the same are not stat-ed again. A cache file whose oldest file stats were read
+ * more than CACHE_MAX_AGE seconds ago is not used at all, so the directory is read and stat-ed again.
+ *
+ * @param fileName the path of the directory
+ * @param dirStat the file stat of the directory
+ * @return 1 if the directory was listed from the cache file, or 0
+ */
+int loadCache(char *fileName, struct linux_statx *dirStat) {
+    struct cacheHeader *h = mapCache(dirStat);
+    unsigned int mask = cacheMask();
+
+    if (h == NULL) {
+        return 0;
+    }
+
+    if ((h->mask & mask) != mask) { //the cache file was written for the other fields
+        releaseCache();
+        return 0;
+    }
+
+    if (!direntOnly && h->verified < currentTime - CACHE_MAX_AGE) { //the changes of the files could have been missed for too long
+        releaseCache();
+        return 0;
+    }
+
+    long newest = (dirStat->stx_mtime.tv_sec > dirStat->stx_ctime.tv_sec) ? dirStat->stx_mtime.tv_sec : dirStat->stx_ctime.tv_sec;
+
+    if (h->mtime.tv_sec != dirStat->stx_mtime.tv_sec || h->mtime.tv_nsec != dirStat->stx_mtime.tv_nsec
+        || h->ctime.tv_sec != dirStat->stx_ctime.tv_sec || h->ctime.tv_nsec != dirStat->stx_ctime.tv_nsec || newest + 1 >= h->snapshot) {
+        if (!direntOnly) {
+            indexCache();
+        }
+        return 0;
+    }
+
+    entries = cachedEntries;
+    cacheHits += 1;
+    refreshHotEntries(fileName, dirStat);
+
+    return 1;
+}
+
+/**
+ * This function reads the file stat of the specific file, and lists the directory or adds the file to the entry table.
+ * The files in the listed directory only request the fields of the output, and if the output only has the names
+ * (i.e. "-o name"), they are not checked at all.
+ *
+ * @param dirFd the file descriptor of the directory that contains the file (or AT_FDCWD)
+ * @param fileName the name of the target file
+ * @param openFlag to check if the program should call the open syscall
+ * @return On success, zero will be returned. Otherwise, some negative value will be returned.
+ */
+int checkFileStat(long dirFd, char *fileName, char openFlag) {
+    long ret = 0;
+
+    struct linux_statx statxBuffer;
+
+    statxBuffer.stx_mode = 0; //the fields that are not requested are printed as 0
+    statxBuffer.stx_nlink = 0;
+    statxBuffer.stx_uid = 0;
+    statxBuffer.stx_gid = 0;
+    statxBuffer.stx_size = 0;
+    statxBuffer.stx_mtime.tv_sec = 0;
+    statxBuffer.stx_ctime.tv_sec = 0;
+    statxBuffer.stx_ino = 0;
+
+    if (openFlag) { //the type of the operand is needed to check if it is a directory (and the times of the directory, for its cache file)
+        unsigned int cacheFields = (cacheDirectory != NULL) ? (STATX_INO | STATX_MTIME | STATX_CTIME) : 0;
+
+        ret = readFileStat(dirFd, fileName, 0, statxMask | STATX_TYPE | cacheFields, &statxBuffer);
+    } else if (statxMask != 0) {
+        ret = readFileStat(dirFd, fileName, 0, statxMask, &statxBuffer);
+    }
+
+    if (ret < 0) { //the file was removed after the getdents64 syscall listed it
+        return ret;
+    }
+
+    mode_t mode = statxBuffer.stx_mode; //mode of file
+
+    //use the bitwise operators to check if the current file is a directory and check if the program should call the open syscall
+    if (S_ISDIR(mode) && openFlag) {
+
+        //the files in the current working directory are printed without the path of the directory
+        if (!(*fileName == '.' && *(fileName + 1) == '\0')) {
+            listPrefix = strconcat(fileName, "/");
+        }
+
+        if (cacheDirectory != NULL && !statxMissing && loadCache(fileName, &statxBuffer)) {
+            return ret;
+        }
+
+        long snapshot = getCurrentTime(); //the changes after this time could be missing in the cache file
+        long reused = cacheReused;
+        int fd = openDirectory(fileName); //open the directory
+
+        getDirectoryEntries(fd);
+        closeFile(fd); //close the directory
+
+        if (cacheDirectory != NULL && !statxMissing && fd >= 0) {
+            //the reused entries still have the file stats of the old cache file, which must not become younger
+            saveCache(&statxBuffer, snapshot, (cacheReused != reused) ? cacheMap->verified : snapshot);
+            releaseCache(); //the cached entries of the changed directory have been copied
+        }
+
+    } else {
+        addEntry(&entries, fileName, &statxBuffer); //the fields are formatted when they are printed out
+    }
+
+    return ret;
+}
+
+/**
+ * This function is the main loop of a worker of the parallel stat. The worker takes STAT_BATCH slots at a time
+ * (in the inode order, with the -I option), and stores the file stat of each entry in its own slot, so the order of
+ * the entries does not depend on the workers.
+ * The workers do not allocate any memory, since the entry table does not grow while they are running.
+ *
+ * @param arg the job of the parallel stat
+ * @return always 0
+ */
+int statWorkerMain(void *arg) {
+    struct statJob *job = (struct statJob *) arg;
+    struct linux_statx statxBuffer;
+
+    for (;;) {
+        long i = __atomic_fetch_add(&job->next, STAT_BATCH, __ATOMIC_RELAXED);
+        long end = (i + STAT_BATCH < job->end) ? i + STAT_BATCH : job->end;
+
+        if (i >= job->end) {
+            return 0;
+        }
+
+        for (; i < end; i++) {
+            long slot = (job->order != NULL) ? job->order[i] : job->first + i;
+            char *name = entries.names + entries.nameOffset[slot];
+
+            job->status[slot - job->first] = readFileStat(job->dirFd, name, 0, statxMask, &statxBuffer);
+            setEntryStat(&entries, slot, &statxBuffer);
+        }
+    }
+}
+
+/**
+ * This function sorts the slots of the listed directory by the inode numbers of the directory entries (the -I option),
+ * so that the inodes are read in the order of the inode table. On ext4 and XFS, the inode table is read ahead
+ * (i.e. inode_readahead_blks), so the following inodes are already in the cache when they are checked.
+ * The order is released with the status array of the parallel stat.
+ *
+ * @param slots the slots to sort, or NULL for every slot from the first one
+ * @param first the first slot of the directory in the entry table
+ * @param count the number of the slots
+ * @return the slots in the inode order
+ */
+unsigned int *sortByInode(unsigned int *slots, long first, long count) {
+    unsigned int *order = (unsigned int *) allocateMemory(count * sizeof(unsigned int) + 1);
+    unsigned int *tempSlots = (unsigned int *) allocateMemory(count * sizeof(unsigned int) + 1);
+    unsigned long *keys = (unsigned long *) allocateMemory(count * sizeof(unsigned long) + 1);
+    unsigned long *tempKeys = (unsigned long *) allocateMemory(count * sizeof(unsigned long) + 1);
+
+    for (long i = 0; i < count; i++) {
+        order[i] = (slots != NULL) ? slots[i] : (unsigned int) (first + i);
+        keys[i] = entries.inode[order[i]];
+    }
+
+    radixSort(keys, order, tempKeys, tempSlots, count);
+
+    return order;
+}
+
+/**
+ * This function reads the file stats of the entries of the listed directory with the workers of the parallel stat (the -P option).
+ * The main thread works as the first worker, and the other workers are created with the clone syscall
+ * (fewer workers are used for the small directories). After every worker has exited, the entries whose files
+ * were removed are dropped in order, and the widths of the columns are updated.
+ *
+ * @param dirFd the file descriptor of the listed directory
+ * @param first the first slot of the directory in the entry table
+ * @param slots the slots to stat (the others already have their file stats), or NULL for every slot from the first one
+ * @param slotCount the number of the slots (ignored for NULL)
+ */
+void statEntries(long dirFd, long first, unsigned int *slots, long slotCount) {
+    long count = entries.count - first;
+    long jobCount = (slots != NULL) ? slotCount : count;
+    long workerCount = (jobCount + STAT_BATCH - 1) / STAT_BATCH;
+    struct statWorker threads[MAX_STAT_WORKERS];
+    int spawned = 1;
+
+    if (workerCount > statWorkers) {
+        workerCount = statWorkers;
+    }
+
+    statJob.dirFd = dirFd;
+    statJob.next = 0;
+    statJob.end = jobCount;
+    statJob.first = first;
+    struct arenaMark mark = markArena(&heap); //the status array is released after the compaction
+    statJob.status = (int *) allocateMemory(count * sizeof(int) + 1);
+    statJob.order = inodeOrder ? sortByInode(slots, first, jobCount) : slots;
+
+    for (long i = 0; i < count; i++) {
+        statJob.status[i] = 0; //the slots that are not stat-ed are kept
+    }
+
+    long stacks = (workerCount > 1) ? mapMemory(workerCount * STAT_WORKER_STACK) : -1;
+
+    for (int i = 1; i < workerCount && stacks >= 0; i++) { //if a thread could not be created, the others do its work
+        char *stackTop = (char *) stacks + (long) (i + 1) * STAT_WORKER_STACK;
+
+        if (spawnThread(statWorkerMain, &statJob, stackTop, &threads[i].tid) < 0) {
+            break;
+        }
+        spawned += 1;
+    }
+
+    statWorkerMain(&statJob);
+
+    for (int i = 1; i < spawned; i++) {
+        joinThread(&threads[i].tid);
+    }
+
+    if (stacks >= 0) {
+        unmapMemory((char *) stacks, workerCount * STAT_WORKER_STACK);
+    }
+
+    long kept = first;
+
+    for (long i = first; i < first + count; i++) {
+        if (statJob.status[i - first] < 0) { //the file was removed after the getdents64 syscall listed it
+            continue;
+        }
+
+        if (kept != i) {
+            entries.mode[kept] = entries.mode[i];
+            entries.link[kept] = entries.link[i];
+            entries.uid[kept] = entries.uid[i];
+            entries.gid[kept] = entries.gid[i];
+            entries.size[kept] = entries.size[i];
+            entries.modTime[kept] = entries.modTime[i];
+            entries.changeTime[kept] = entries.changeTime[i];
+            entries.inode[kept] = entries.inode[i];
+            entries.isDir[kept] = entries.isDir[i];
+            entries.nameOffset[kept] = entries.nameOffset[i];
+        }
+
+        updateColumnWidths(&entries, kept);
+        kept += 1;
+    }
+
+    entries.count = kept;
+    resetArena(&heap, mark);
+}
+
+/**
+ * This function writes the given bytes to the stdout. A short write is continued from where it stopped.
+ *
+ * @param text the bytes that should be written
+ * @param len the number of bytes
+ */
+void writeAllOut(const char *text, long len) {
+    while (len > 0) {
+        long ret = writeFile(1, text, len);
+        outputWrites += 1;
+
+        if (ret == -4) { //EINTR, so try again
+            continue;
+        } else if (ret < 0) { //i.e. the reader of the pipe exited, so the rest of the output is dropped
+            return;
+        }
+
+        text += ret;
+        len -= ret;
+    }
+}
+
+/**
+ * This function writes the output buffer to the stdout with a single write syscall, and empties the buffer.
+ * It is called when the buffer is full, and once before the myls exits.
+ */
+void flushOutput() {
+    writeAllOut(outputBuffer, outputLength);
+    outputLength = 0;
+}
+
+/**
+ * This function makes sure that the output buffer has enough room for the given number of bytes,
+ * so that the caller could format the field directly in the buffer.
+ *
+ * @param len the number of bytes (at most OUTPUT_BUFFER_SIZE)
+ * @return the pointer to the free space of the output buffer
+ */
+char *reserveOutput(long len) {
+    if (len > OUTPUT_BUFFER_SIZE - outputLength) {
+        flushOutput();
+    }
+
+    return outputBuffer + outputLength;
+}
+
+/**
+ * This function adds the bytes that were formatted by the caller (after the reserveOutput()) to the output buffer.
+ * In the unbuffered mode (the -u option), the bytes are written immediately.
+ *
+ * @param len the number of bytes
+ */
+void commitOutput(long len) {
+    outputLength += len;
+
+    if (unbufferedOutput) {
+        flushOutput();
+    }
+}
+
+/**
+ * This function prints out the given string by appending it to the output buffer.
+ * A string that is bigger than the buffer is written directly after the buffered output.
+ *
+ * @param text the target text that should be printed out
+ * @return the length of the text
+ */
+int printOut(const char *text) {
+    int len = strlength(text);
+
+    if (len > OUTPUT_BUFFER_SIZE) {
+        flushOutput();
+        writeAllOut(text, len);
+        return len;
+    }
+
+    strcopy(reserveOutput(len), text, len);
+    commitOutput(len);
+
+    return len;
+}
+
+/**
+ * This function prints out the number of the getdents64 syscalls and the entries via stderr stream (the -T option).
+ */
+void printDirentStats() {
+    char num[21];
+
+    printErr("myls getdents64: ");
+    printErr(formatNumber(direntCalls, num));
+    printErr(" calls, ");
+    printErr(formatNumber(direntCount, num));
+    printErr(" entries, ");
+    printErr(formatNumber(direntCalls > 0 ? direntCount / direntCalls : 0, num));
+    printErr(" entries per call\n");
+}
+
+/**
+ * This is a wrapper function of the time syscall.
+ * The aim of this function is to get the current time by using the time system call.
+ *
+ * @return ret On success, the value of time in seconds since the Epoch is returned. Otherwise, returns -1.
+ */
+int getCurrentTime() {
+    return syscall1(TIME_SYSCALL, 0);
+}
+
+/**
+ * This function returns the key of the given entry for the radix sort, mapped to an unsigned number,
+ * so that the smaller key is printed out first (i.e. the newer time and the bigger size have the smaller keys).
+ *
+ * @param i the slot of the entry
+ * @return the key
+ */
+unsigned long sortValue(long i) {
+    if (sortKey == SORT_TIME) {
+        return ~((unsigned long) entries.modTime[i] ^ (1UL << 63)); //flip the sign bit, so that the negative times are smaller
+    } else if (sortKey == SORT_SIZE) {
+        return ~entries.size[i];
+    }
+
+    return entries.inode[i];
+}
+
+/**
+ * This function packs the bytes of the given name from the given depth into a 64-bit key (big-endian),
+ * so that the keys are in the same order as the names. The bytes after the end of the name are 0.
+ *
+ * @param name the name
+ * @param depth the number of bytes that are already sorted
+ * @return the key
+ */
+unsigned long namePrefix(const char *name, long depth) {
+    const unsigned char *p = (const unsigned char *) name + depth;
+    unsigned long key = 0;
+    int i = 0;
+
+    while (i < NAME_PREFIX && p[i] != '\0') {
+        key |= (unsigned long) p[i] << (8 * (NAME_PREFIX - 1 - i));
+        i += 1;
+    }
+
+    return key;
+}
+
+/**
+ * This function compares the entries in the order of the output, by the key of the sort and then by the name.
+ *
+ * @param a the slot of the first entry
+ * @param b the slot of the second entry
+ * @return a negative value if the first entry is printed out first, 0 if they are equal, or a positive value
+ */
+int compareEntries(unsigned int a, unsigned int b) {
+    if (sortKey != SORT_NAME) {
+        unsigned long keyA = sortValue(a);
+        unsigned long keyB = sortValue(b);
+
+        if (keyA != keyB) {
+            return (keyA < keyB) ? -1 : 1;
+        }
+    }
+
+    return strCompare(entries.names + entries.nameOffset[a], entries.names + entries.nameOffset[b]);
+}
+
+/**
+ * This function sorts the slots by their keys with the LSD radix sort (one byte per pass), which is stable.
+ * The histograms of every byte are counted in a single pass, and the passes where every key has the same byte are skipped.
+ *
+ * @param keys the keys of the slots
+ * @param slots the slots
+ * @param tempKeys the temporary array for the keys (the same size)
+ * @param tempSlots the temporary array for the slots (the same size)
+ * @param n the number of the slots
+ */
+void radixSort(unsigned long *keys, unsigned int *slots, unsigned long *tempKeys, unsigned int *tempSlots, long n) {
+    long counts[8][RADIX_BUCKETS];
+    unsigned long *srcKeys = keys, *dstKeys = tempKeys;
+    unsigned int *srcSlots = slots, *dstSlots = tempSlots;
+
+    if (n < 2) {
+        return;
+    }
+
+    for (int pass = 0; pass < 8; pass++) {
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            counts[pass][b] = 0;
+        }
+    }
+
+    for (long i = 0; i < n; i++) {
+        for (int pass = 0; pass < 8; pass++) {
+            counts[pass][(keys[i] >> (8 * pass)) & 255] += 1;
+        }
+    }
+
+    for (int pass = 0; pass < 8; pass++) {
+        long *count = counts[pass];
+        long offset = 0;
+
+        if (count[(keys[0] >> (8 * pass)) & 255] == n) { //every key has the same byte
+            continue;
+        }
+
+        for (int b = 0; b < RADIX_BUCKETS; b++) { //the counts become the first positions of the buckets
+            long c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (long i = 0; i < n; i++) {
+            long pos = count[(srcKeys[i] >> (8 * pass)) & 255]++;
+            dstKeys[pos] = srcKeys[i];
+            dstSlots[pos] = srcSlots[i];
+        }
+
+        unsigned long *swapKeys = srcKeys;
+        unsigned int *swapSlots = srcSlots;
+        srcKeys = dstKeys;
+        srcSlots = dstSlots;
+        dstKeys = swapKeys;
+        dstSlots = swapSlots;
+    }
+
+    if (srcKeys != keys) { //an odd number of passes, so the result is in the temporary arrays
+        for (long i = 0; i < n; i++) {
+            keys[i] = srcKeys[i];
+            slots[i] = srcSlots[i];
+        }
+    }
+}
+
+/**
+ * This function sorts the slots by the names with the insertion sort, for the small groups.
+ * The first bytes of the names (up to the depth) are the same, so they are skipped.
+ *
+ * @param slots the slots
+ * @param n the number of the slots
+ * @param depth the number of bytes that are already sorted
+ */
+void insertionSortNames(unsigned int *slots, long n, long depth) {
+    for (long i = 1; i < n; i++) {
+        unsigned int slot = slots[i];
+        char *name = entries.names + entries.nameOffset[slot] + depth;
+        long j = i;
+
+        while (j > 0 && strCompare(name, entries.names + entries.nameOffset[slots[j - 1]] + depth) < 0) {
+            slots[j] = slots[j - 1];
+            j -= 1;
+        }
+
+        slots[j] = slot;
+    }
+}
+
+/**
+ * This function sorts the slots by the names with the MSD radix sort. The next 8 bytes of the names are packed into
+ * the keys and sorted with the radix sort, and then each group of the names that have the same 8 bytes is sorted
+ * by the following bytes in the same way. The small groups are sorted with the insertion sort.
+ *
+ * @param slots the slots
+ * @param keys the array for the keys (the same size)
+ * @param tempKeys the temporary array for the keys (the same size)
+ * @param tempSlots the temporary array for the slots (the same size)
+ * @param n the number of the slots
+ * @param depth the number of bytes that are already sorted
+ */
+void sortNames(unsigned int *slots, unsigned long *keys, unsigned long *tempKeys, unsigned int *tempSlots, long n, long depth) {
+    if (n < SMALL_SORT) {
+        insertionSortNames(slots, n, depth);
+        return;
+    }
+
+    for (long i = 0; i < n; i++) {
+        keys[i] = namePrefix(entries.names + entries.nameOffset[slots[i]], depth);
+    }
+
+    radixSort(keys, slots, tempKeys, tempSlots, n);
+
+    for (long start = 0; start < n;) {
+        long end = start + 1;
+
+        while (end < n && keys[end] == keys[start]) {
+            end += 1;
+        }
+
+        if (end - start > 1 && (keys[start] & 255) != 0) { //the names are longer than the key, so sort them by the next bytes
+            sortNames(slots + start, keys + start, tempKeys + start, tempSlots + start, end - start, depth + NAME_PREFIX);
+        }
+
+        start = end;
+    }
+}
+
+/**
+ * This function moves the first n entries of the output order to the front of the slots (the quickselect),
+ * without sorting the rest, so that the -N option does not sort every entry.
+ *
+ * @param slots the slots
+ * @param count the number of the slots
+ * @param n the number of the entries to select
+ */
+void selectEntries(unsigned int *slots, long count, long n) {
+    long left = 0;
+    long right = count - 1;
+    int sign = reverseOrder ? -1 : 1; //the reversed order selects the last entries
+
+    while (left < right) {
+        unsigned int pivot = slots[left + (right - left) / 2];
+        long i = left;
+        long j = right;
+
+        while (i <= j) {
+            while (sign * compareEntries(slots[i], pivot) < 0) i += 1;
+            while (sign * compareEntries(slots[j], pivot) > 0) j -= 1;
+
+            if (i <= j) {
+                unsigned int temp = slots[i];
+                slots[i] = slots[j];
+                slots[j] = temp;
+                i += 1;
+                j -= 1;
+            }
+        }
+
+        if (n - 1 <= j) {
+            right = j;
+        } else if (n - 1 >= i) {
+            left = i;
+        } else {
+            return;
+        }
+    }
+}
+
+/**
+ * This function sorts the entry table by the key of the sort (the -s option), and stores the order in the entryOrder.
+ * The entries are sorted by the names first, and then by the key with the stable radix sort, so that the entries
+ * with the same key are in the order of the names. With the -N option, only the selected entries are sorted.
+ */
+void sortEntries() {
+    long count = entries.count;
+    long n = (topCount >= 0 && topCount < count) ? topCount : count;
+
+    entryOrder = (unsigned int *) allocateMemory(count * sizeof(unsigned int) + 1);
+
+    for (long i = 0; i < count; i++) {
+        entryOrder[i] = (unsigned int) i;
+    }
+
+    if (n < count) {
+        selectEntries(entryOrder, count, n);
+    }
+
+    unsigned long *keys = (unsigned long *) allocateMemory(n * sizeof(unsigned long) + 1);
+    unsigned long *tempKeys = (unsigned long *) allocateMemory(n * sizeof(unsigned long) + 1);
+    unsigned int *tempSlots = (unsigned int *) allocateMemory(n * sizeof(unsigned int) + 1);
+
+    sortNames(entryOrder, keys, tempKeys, tempSlots, n, 0);
+
+    if (sortKey != SORT_NAME) {
+        for (long i = 0; i < n; i++) {
+            keys[i] = sortValue(entryOrder[i]);
+        }
+
+        radixSort(keys, entryOrder, tempKeys, tempSlots, n);
+    }
+
+    if (reverseOrder) {
+        for (long i = 0, j = n - 1; i < j; i++, j--) {
+            unsigned int temp = entryOrder[i];
+            entryOrder[i] = entryOrder[j];
+            entryOrder[j] = temp;
+        }
+    }
+}
+
+/**
+ * This function prints out the entries of the entry table (in the sorted order, if they are sorted), and each line is formatted directly in the output buffer.
+ * The widths of the columns are the widths of the largest values in the table, or the widths of the largest values
+ * of their types in the streaming mode (the -S option), so that the lines of every getdents64 buffer are aligned.
+ */
+void printEntries() {
+    int linkWidth = streamOutput ? STREAM_LINK_WIDTH : countDigits(entries.maxLink);
+    int uidWidth = streamOutput ? STREAM_ID_WIDTH : countDigits(entries.maxUid);
+    int gidWidth = streamOutput ? STREAM_ID_WIDTH : countDigits(entries.maxGid);
+    int sizeWidth = streamOutput ? STREAM_SIZE_WIDTH : countDigits(entries.maxSize);
+    int inodeWidth = streamOutput ? STREAM_SIZE_WIDTH : countDigits(entries.maxInode);
+    int prefixLength = strlength(listPrefix);
+    long count = (topCount >= 0 && topCount < entries.count) ? topCount : entries.count;
+
+    for (long k = 0; k < count; k++) {
+        long i = (entryOrder != NULL) ? entryOrder[k] : k;
+        char *name = entries.names + entries.nameOffset[i];
+        int nameLength = strlength(name);
+
+        //5 numbers (at most 21 bytes each), the file permission (12 bytes), the time (13 bytes), the type (2 bytes), the path and the new line
+        char *line = reserveOutput(5 * 21 + 12 + 13 + 2 + prefixLength + nameLength + 1);
+        char *temp = line;
+
+        if (outputFields & FIELD_INODE) temp = formatColumn(temp, inodeWidth, entries.inode[i]);
+
+        if (outputFields & FIELD_MODE) {
+            checkFilePermission(temp, entries.mode[i]);
+            temp += 11;
+        }
+
+        /* make each line the same fixed length by padding the columns with whitespace characters */
+        if (outputFields & FIELD_LINKS) temp = formatColumn(temp, linkWidth, entries.link[i]);
+        if (outputFields & FIELD_UID) temp = formatColumn(temp, uidWidth, entries.uid[i]);
+        if (outputFields & FIELD_GID) temp = formatColumn(temp, gidWidth, entries.gid[i]);
+        if (outputFields & FIELD_SIZE) temp = formatColumn(temp, sizeWidth, entries.size[i]);
+        if (outputFields & FIELD_TIME) temp = formatModTime(temp, entries.modTime[i]);
+
+        if (outputFields & FIELD_TYPE) {
+            *temp++ = fileTypes[(entries.mode[i] >> 12) & 15];
+            *temp++ = ' ';
+        }
+
+        strcopy(temp, listPrefix, prefixLength); //the path of the listed directory
+        temp += prefixLength;
+        strcopy(temp, name, nameLength);
+        temp += nameLength;
+        *temp++ = '\n';
+
+        commitOutput(temp - line);
+    }
+}
+
+/**
+ * This function reads the file stat(s) and print out the file stat(s).
+ * The file stats are collected in the entry table first, so that the widths of the columns are known,
+ * and then each line is formatted directly in the output buffer in a single pass.
+ *
+ * @param fileName the name of the target file (or directory)
  */
 void util(char *fileName) {
+    initEntryTable(&entries);
+    listPrefix = "";
+
+    entryOrder = NULL;
+
+    checkFileStat(AT_FDCWD, fileName, 1);
+
+    if (sortKey != SORT_NONE) {
+        sortEntries();
+    }
+
+    printEntries();
+    releaseCache(); //the entries could be printed straight from the cache file of the directory
+}
+
+/**
+ * This function pushes the given directory to the stack of the recursive listing.
+ *
+ * @param top the top of the stack
+ * @param prefix the path of the parent directory, with the trailing "/" (or "" for the current directory)
+ * @param name the name of the directory
+ * @return the new top of the stack
+ */
+struct pendingDir *pushPendingDir(struct pendingDir *top, const char *prefix, const char *name) {
+    int prefixLength = strlength(prefix);
+    int nameLength = strlength(name);
+    struct pendingDir *dir = (struct pendingDir *) allocateFromArena(&walkArena, sizeof(struct pendingDir) + prefixLength + nameLength + 1);
+
+    if (dir == NULL) {
+        flushOutput();
+        printErr("myls: out of memory\n");
+        exitProcess(1);
+    }
+
+    dir->path = (char *) (dir + 1);
+    strcopy(dir->path, prefix, prefixLength);
+    strcopy(dir->path + prefixLength, name, nameLength + 1);
+    dir->below = top;
+    dir->end = markArena(&walkArena);
+
+    return dir;
+}
+
+/**
+ * This function lists the given directory and all of its sub-directories (the -R option), without the recursion.
+ * The directories that are waiting to be listed are kept in an explicit stack, and each directory is listed
+ * just like the util() (with its own entry table and its own widths of the columns), and then its sub-directories
+ * are pushed in the reverse order of the output, so they are listed in the order of the output (depth first).
+ * The symbolic links to the directories are not followed. The stack and the paths are allocated from the walk arena:
+ * when a directory is popped, every directory above it has been listed, so they are released at once.
+ *
+ * @param fileName the name of the target directory (or file)
+ */
+void listTree(char *fileName) {
+    struct arenaMark start = markArena(&walkArena);
+    struct pendingDir *top = pushPendingDir(NULL, "", fileName);
+
+    while (top != NULL) {
+        struct pendingDir *dir = top;
+        struct arenaMark mark = markArena(&heap); //the file stats of this directory are released after printing them
+
+        top = dir->below;
+        resetArena(&walkArena, dir->end); //the directories above this one are already listed
+
+        initEntryTable(&entries);
+        listPrefix = "";
+        entryOrder = NULL;
+
+        printOut(dir->path);
+        printOut(" :\n");
+
+        checkFileStat(AT_FDCWD, dir->path, 1);
+
+        if (sortKey != SORT_NONE) {
+            sortEntries();
+        }
+
+        printEntries();
+        printOut("\n");
+
+        for (long k = entries.count - 1; k >= 0; k--) { //the first sub-directory of the output ends up on the top
+            long i = (entryOrder != NULL) ? entryOrder[k] : k;
+
+            if (entries.isDir[i]) {
+                top = pushPendingDir(top, listPrefix, entries.names + entries.nameOffset[i]);
+            }
+        }
+
+        releaseCache();
+        resetArena(&heap, mark);
+    }
+
+    resetArena(&walkArena, start);
+}
+
+/**
+ * This function returns the file type of the given directory entry (the d_type, which is the same as the S_IFMT bits of the mode, shifted by 12).
+ * Only if the file system does not fill the d_type, the type is read with the statx syscall.
+ *
+ * @param dirFd the file descriptor of the listed directory
+ * @param ld the directory entry
+ * @return the file type, from 0 to 15
+ */
+int direntType(long dirFd, struct linux_dirent64 *ld) {
+    if (ld->d_type == DT_UNKNOWN && (outputFields & FIELD_TYPE)) {
+        struct linux_statx statxBuffer;
+
+        statxBuffer.stx_mode = 0;
+        readFileStat(dirFd, ld->d_name, 0, STATX_TYPE, &statxBuffer);
+
+        return (statxBuffer.stx_mode >> 12) & 15;
+    }
 
-    fs = (struct fileStat *)mysbrk(sizeof(struct fileStat)); // allocate the memory for the linked list that stores the file stat.
-    currentNode = fs;
-    currentNode->next = NULL;
+    return ld->d_type & 15;
+}
+
+/**
+ * This function checks if the given directory entry is a sub-directory, for the recursive listing (the -R option).
+ * The symbolic links to the directories are not followed, so the listing never loops.
+ * Only if the file system does not fill the d_type, the type is read with the statx syscall.
+ *
+ * @param dirFd the file descriptor of the listed directory
+ * @param ld the directory entry
+ * @return 1 if the entry is a sub-directory, or 0
+ */
+char isDirectoryEntry(long dirFd, struct linux_dirent64 *ld) {
+    if (ld->d_type == DT_UNKNOWN) {
+        struct linux_statx statxBuffer;
+
+        statxBuffer.stx_mode = 0;
+        readFileStat(dirFd, ld->d_name, AT_SYMLINK_NOFOLLOW, STATX_TYPE, &statxBuffer);
+
+        return S_ISDIR(statxBuffer.stx_mode);
+    }
 
-    checkFileStat(fileName, 1);
+    return ld->d_type == DT_DIR;
+}
+
+/**
+ * This function appends the given directory entry to the entry table without its file stat, so that the entries could be sorted.
+ * The inode number and the file type are taken from the directory entry.
+ *
+ * @param dirFd the file descriptor of the listed directory
+ * @param ld the directory entry
+ */
+void appendDirent(long dirFd, struct linux_dirent64 *ld) {
+    long i = appendEntry(&entries, ld->d_name);
 
-    while (fs->next) { //use the while loop to iterate the linked list of the file stat
-    
-        printOut(fs->fileInfo); //print out the file permission
+    entries.inode[i] = ld->d_ino;
+    entries.mode[i] = (mode_t) direntType(dirFd, ld) << 12;
+    updateColumnWidths(&entries, i);
+}
 
-        /* make each line the same fixed length by appending suitable number of whitespace characters */
-        checkLengthForOutput(lengthOfLink, fs->link);
-        checkLengthForOutput(lengthOfUID, fs->uid);
-        checkLengthForOutput(lengthOfGID, fs->gid);
-        checkLengthForOutput(lengthOfFileSize, fs->fileSize);
+/**
+ * This function prints out the given directory entry straight from the getdents64 buffer, without its file stat
+ * (the name-only, the "-o type,name" and the "-o inode,name" outputs). The type of the entry comes from the d_type,
+ * so the symbolic links are printed as "l". Only if the file system does not fill the d_type, the type is read with the statx syscall.
+ * The columns are not padded, since the widths are not known until the end of the directory.
+ *
+ * @param dirFd the file descriptor of the listed directory
+ * @param ld the directory entry
+ */
+void printDirent(long dirFd, struct linux_dirent64 *ld) {
+    int prefixLength = strlength(listPrefix);
+    int nameLength = strlength(ld->d_name);
 
-        printOut(fs->modTime); //print out the last modified time
+    //the inode number (at most 21 bytes), the type (2 bytes), the path and the new line
+    char *line = reserveOutput(21 + 2 + prefixLength + nameLength + 1);
+    char *temp = line;
 
-        char *name = strconcat(fs->fileName, "\n"); //concatenate the file name and next line character
-        printOut(name);                             //print out the file name, and move to the next line
+    if (outputFields & FIELD_INODE) {
+        temp = formatColumn(temp, 0, ld->d_ino);
+    }
 
-        fs = fs->next;
+    if (outputFields & FIELD_TYPE) {
+        *temp++ = fileTypes[direntType(dirFd, ld)];
+        *temp++ = ' ';
     }
+
+    strcopy(temp, listPrefix, prefixLength);
+    temp += prefixLength;
+    strcopy(temp, ld->d_name, nameLength);
+    temp += nameLength;
+    *temp++ = '\n';
+
+    commitOutput(temp - line);
 }
 
 /**
@@ -742,56 +2886,245 @@ void printFileNotExists(char *fileName) {
     printOut(errMessage2);
 }
 
-/* The aim of the myls is to implement the software, which works just like the "ls -n" command, by using the system call */
-int main(int argc, char **argv) {
+/**
+ * This function parses the fields of the -o option (i.e. "mode,size,time"), and builds the request mask of the statx syscall,
+ * so that the statx syscall only requests the fields of the output. "name" selects no field, since the name is always printed.
+ * If there are only the fields of the directory entries ("inode", "type" and "name"), the files of the listed directory are not checked.
+ *
+ * @param value the comma-separated list of the fields
+ * @return the fields, or -1 if there is an invalid field
+ */
+int parseFields(char *value) {
+    const char *names[9] = { "mode", "links", "uid", "gid", "size", "time", "inode", "type", "name" };
+    const unsigned int masks[9] = { STATX_TYPE | STATX_MODE, STATX_NLINK, STATX_UID, STATX_GID, STATX_SIZE, STATX_MTIME, STATX_INO, STATX_TYPE, 0 };
+    int fields = 0;
 
-    time_t time = getCurrentTime(); //use the system call "time" to get the current time
-    struct tm *now = localtime(&time);
-    currentYear = now->tm_year;
+    statxMask = 0;
 
-    if (argc == 2) {
-        // use the access syscall to check if the file exists
-        if (accessToFile(argv[1]) != 0) {
-            printFileNotExists(argv[1]);
-        } else {
-            initHeap(); //use the mmap syscall to get the virtual memory for dynamic memory allocation
+    while (*value != '\0') {
+        char field[8];
+        int length = 0;
 
-            util(argv[1]);
+        while (value[length] != '\0' && value[length] != ',') {
+            length += 1;
+        }
 
-            myUnMap(); // use the munmap syscall to unmap the virtual memory.
+        if (length >= 8) {
+            return -1;
         }
 
-    } else if (argc > 2) {
-        int i;
-        for (i = 1; i < argc; i++) {
+        strcopy(field, value, length);
+        field[length] = '\0';
 
-            if (accessToFile(argv[i]) != 0) { //use the access syscall to check if the file exists
-                printFileNotExists(argv[i]);
-            } else {
-                initHeap(); //use the mmap syscall to get the virtual memory for dynamic memory allocation
+        int j = 0;
+        while (j < 9 && strCompare(field, names[j]) != 0) {
+            j += 1;
+        }
+
+        if (j == 9) {
+            return -1;
+        }
+
+        fields |= (1 << j) & (ALL_FIELDS | FIELD_INODE | FIELD_TYPE);
+        statxMask |= masks[j];
 
-                char *msg = strconcat(argv[i], " :\n");
-                printOut(msg);
+        value += length + (value[length] == ',');
+    }
+
+    direntOnly = ((fields & ALL_FIELDS) == 0);
+
+    return fields;
+}
+
+/**
+ * This function parses the key of the -s option.
+ *
+ * @param value the name of the key (name, time, size or inode)
+ * @return the key, or -1 if the key is invalid
+ */
+int parseSortKey(const char *value) {
+    const char *names[4] = { "name", "time", "size", "inode" };
+
+    for (int i = 0; i < 4; i++) {
+        if (strCompare(value, names[i]) == 0) {
+            return SORT_NAME + i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * This function parses the command line options, and collects the operands (the files to list).
+ *
+ *   -T        prints out the current and the peak usage of the custom heap
+ *   -u        writes every line as soon as it is formatted, instead of buffering the output
+ *   -o FIELDS prints out only the given fields (a comma-separated list of mode, links, uid, gid, size, time, inode, type and name)
+ *   -D        uses the cached attributes of the network file systems (AT_STATX_DONT_SYNC)
+ *   -P N      reads the file stats of the listed directory with N worker threads
+ *   -S        prints out the entries of each getdents64 buffer with fixed widths, before reading the next one
+ *   -I        reads the file stats in the order of the inode numbers
+ *   -R        lists the sub-directories recursively
+ *   -C DIR    keeps the entry table of each listed directory in a cache file in DIR, and lists the unchanged directories from it
+ *   -s KEY    sorts the entries by the key (name, time, size or inode)
+ *   -r        reverses the order of the sort (with -s)
+ *   -N n      prints out only the first n entries of the order (with -s, i.e. "-s size -N 10" for the 10 largest files)
+ *
+ * @param argc the number of command line arguments
+ * @param argv the command line arguments
+ * @param operands the array to store the operands
+ * @return the number of operands, or -1 if there is an invalid option
+ */
+int parseOptions(int argc, char **argv, char **operands) {
+    int count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+
+        if (arg[0] != '-' || arg[1] == '\0') { //an operand
+            operands[count] = arg;
+            count += 1;
+            continue;
+        }
+
+        if (arg[2] != '\0') {
+            return -1;
+        }
+
+        if (arg[1] == 'T') {
+            showStats = 1;
+        } else if (arg[1] == 'u') {
+            unbufferedOutput = 1;
+        } else if (arg[1] == 'r') {
+            reverseOrder = 1;
+        } else if (arg[1] == 's' && i + 1 < argc) {
+            if ((sortKey = parseSortKey(argv[++i])) < 0) {
+                return -1;
+            }
+        } else if (arg[1] == 'N' && i + 1 < argc) {
+            if ((topCount = parseNumber(argv[++i])) < 0) {
+                return -1;
+            }
+        } else if (arg[1] == 'R') {
+            recursive = 1;
+        } else if (arg[1] == 'C' && i + 1 < argc) {
+            cacheDirectory = argv[++i];
+        } else if (arg[1] == 'I') {
+            inodeOrder = 1;
+        } else if (arg[1] == 'S') {
+            streamOutput = 1;
+        } else if (arg[1] == 'D') {
+            statxFlags = AT_STATX_DONT_SYNC;
+        } else if (arg[1] == 'P' && i + 1 < argc) {
+            statWorkers = parseNumber(argv[++i]);
+
+            if (statWorkers < 1 || statWorkers > MAX_STAT_WORKERS) {
+                return -1;
+            }
+        } else if (arg[1] == 'o' && i + 1 < argc) {
+            if ((outputFields = parseFields(argv[++i])) < 0) {
+                return -1;
+            }
+        } else {
+            return -1;
+        }
+    }
 
-                util(argv[i]);
+    if (streamOutput && (sortKey != SORT_NONE || recursive || cacheDirectory != NULL)) { //the entries could not be sorted (or their sub-directories listed, or cached) before the end of the directory
+        return -1;
+    }
+
+    if (sortKey == SORT_NONE && (reverseOrder || topCount >= 0)) { //the -r and -N options only change the order of the sort
+        return -1;
+    }
+
+    if (sortKey == SORT_TIME || sortKey == SORT_SIZE) { //the key is read with the statx syscall, even if it is not printed out
+        statxMask |= (sortKey == SORT_TIME) ? STATX_MTIME : STATX_SIZE;
+        direntOnly = 0;
+    } else if (sortKey == SORT_INODE) {
+        statxMask |= STATX_INO; //the directory entries already have the inode numbers, but the stat of the operand does not
+    }
+
+    if (cacheDirectory != NULL && !direntOnly) { //the cached entries are matched by their inode numbers, and the hot ones are found by their last status changes
+        statxMask |= STATX_INO | STATX_CTIME;
+    }
+
+    return count;
+}
+
+/* The aim of the myls is to implement the software, which works just like the "ls -n" command, by using the system call */
+int main(int argc, char **argv, char **envp) {
+    char *operands[argc];
+    int count = parseOptions(argc, argv, operands);
+
+    if (count <= 0) {
+        char usageMsg[109] = "Usage: ./myls [-T] [-u] [-S] [-I] [-R] [-D] [-C DIR] [-o FIELDS] [-P N] [-s KEY [-r] [-N n]] \"file_path\"\n";
+        printOut(usageMsg);
+        flushOutput();
+        return 1;
+    }
+
+    initHeap(); //the heap is mapped lazily, when the first chunk is needed
 
-                myUnMap(); // use the munmap syscall to unmap the virtual memory.
+    initArena(&walkArena);
+    loadLocalZone(envp); //the time zone stays in the heap for every operand
+    currentTime = getCurrentTime(); //use the system call "time" to get the current time
+    currentYear = localYear(currentTime);
+
+    for (int i = 0; i < count; i++) {
+        if (accessToFile(operands[i]) != 0) { //use the access syscall to check if the file exists
+            printFileNotExists(operands[i]);
+        } else {
+            if (recursive) { //every directory is printed out with its path, and its file stats are released after printing them
+                listTree(operands[i]);
+                continue;
+            }
+
+            struct arenaMark mark = markArena(&heap); //the file stats of this operand are released after printing them
+
+            if (count > 1) {
+                printOut(operands[i]);
+                printOut(" :\n");
             }
- 
+
+            util(operands[i]);
+
+            resetArena(&heap, mark);
+        }
+
+        if (count > 1 && !recursive) {
             char nl[2] = "\n";
             printOut(nl);
-
-            //reset the digit counts to 0
-            lengthOfFileSize = 0;
-            lengthOfLink = 0;
-            lengthOfGID = 0;
-            lengthOfUID = 0;
         }
+    }
 
-    } else {
-        char usageMsg[27] = "Usage: ./myls \"file_path\"\n";
-        printOut(usageMsg);
+    flushOutput(); //write the rest of the output
+
+    if (showStats) {
+        char num[21];
+
+        printArenaStats("myls heap", &heap);
+        printDirentStats();
+        printErr("myls stat: ");
+        printErr(formatNumber(statCalls, num));
+        printErr(" syscalls\n");
+        printErr("myls output: ");
+        printErr(formatNumber(outputWrites, num));
+        printErr(" write syscalls\n");
+
+        if (cacheDirectory != NULL) {
+            printErr("myls cache: ");
+            printErr(formatNumber(cacheHits, num));
+            printErr(" directories from the cache files, ");
+            printErr(formatNumber(cacheReused, num));
+            printErr(" entries reused, ");
+            printErr(formatNumber(cacheWrites, num));
+            printErr(" cache files written\n");
+        }
     }
 
+    myUnMap(); // use the munmap syscall to unmap the virtual memory.
+    releaseArena(&walkArena);
+
     return 1;
-}
\ No newline at end of file
+}
@@ -0,0 +1,412 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/*
+ * The system call layer that is shared by the myls, the mycp and the mycat.
+ *
+ * The syscallN() functions bind the number and the arguments of the system call straight to the registers of
+ * the x86_64 syscall convention (rax, rdi, rsi, rdx, r10, r8 and r9) with the register constraints, so the compiler
+ * loads each argument into its register directly (without the movq through a scratch register), and every wrapper
+ * is inlined into its caller. The syscall instruction overwrites the rcx and the r11, and the kernel returns -errno
+ * (from -4095 to -1) on error, which is returned as it is.
+ *
+ * @reference https://man7.org/linux/man-pages/man2/syscall.2.html
+ */
+
+/* The system call numbers of the shared wrappers */
+#define READ_SYSCALL 0         //to read the opened file
+#define WRITE_SYSCALL 1        //to write to the opened file (or the stdout and the stderr)
+#define CLOSE_SYSCALL 3        //to close the opened directory or file
+#define FSTAT_SYSCALL 5        //to get the file stat of the opened file
+#define MMAP_SYSCALL 9         //to map the memory (or the file)
+#define MUNMAP_SYSCALL 11      //to unmap the mapped memory
+#define ACCESS_SYSCALL 21      //to check if the file exists
+#define EXIT_GROUP_SYSCALL 231 //to terminate the process with all of its threads
+
+/**
+ * This function calls the system call without any argument.
+ *
+ * @param number the system call number
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall0(long number) {
+    long ret;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 1 argument (in the rdi).
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall1(long number, long arg1) {
+    long ret;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 2 arguments (in the rdi and the rsi).
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @param arg2 the second argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall2(long number, long arg1, long arg2) {
+    long ret;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1), "S"(arg2)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 3 arguments (in the rdi, the rsi and the rdx).
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @param arg2 the second argument
+ * @param arg3 the third argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall3(long number, long arg1, long arg2, long arg3) {
+    long ret;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1), "S"(arg2), "d"(arg3)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 4 arguments. There is no constraint for the r10,
+ * so the fourth argument is bound to the r10 with a register variable.
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @param arg2 the second argument
+ * @param arg3 the third argument
+ * @param arg4 the fourth argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall4(long number, long arg1, long arg2, long arg3, long arg4) {
+    long ret;
+    register long r10 asm("r10") = arg4;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1), "S"(arg2), "d"(arg3), "r"(r10)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 5 arguments (the fifth one in the r8).
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @param arg2 the second argument
+ * @param arg3 the third argument
+ * @param arg4 the fourth argument
+ * @param arg5 the fifth argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall5(long number, long arg1, long arg2, long arg3, long arg4, long arg5) {
+    long ret;
+    register long r10 asm("r10") = arg4;
+    register long r8 asm("r8") = arg5;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1), "S"(arg2), "d"(arg3), "r"(r10), "r"(r8)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function calls the system call with 6 arguments (the sixth one in the r9).
+ *
+ * @param number the system call number
+ * @param arg1 the first argument
+ * @param arg2 the second argument
+ * @param arg3 the third argument
+ * @param arg4 the fourth argument
+ * @param arg5 the fifth argument
+ * @param arg6 the sixth argument
+ * @return the return value of the system call (-errno on error)
+ */
+static inline long syscall6(long number, long arg1, long arg2, long arg3, long arg4, long arg5, long arg6) {
+    long ret;
+    register long r10 asm("r10") = arg4;
+    register long r8 asm("r8") = arg5;
+    register long r9 asm("r9") = arg6;
+
+    asm volatile("syscall"
+        : "=a"(ret)
+        : "a"(number), "D"(arg1), "S"(arg2), "d"(arg3), "r"(r10), "r"(r8), "r"(r9)
+        : "rcx", "r11", "memory");
+
+    return ret;
+}
+
+/**
+ * This function is a wrapper function of the read system call.
+ *
+ * @param fd the file descriptor of the opened file
+ * @param buf the buffer to store the bytes
+ * @param len the size of the buffer
+ * @return On success, the number of bytes read is returned (0 at the end of the file). On error, -errno is returned.
+ */
+static inline long readFile(long fd, char *buf, long len) {
+    return syscall3(READ_SYSCALL, fd, (long) buf, len);
+}
+
+/**
+ * This function is a wrapper function of the write system call. It could write fewer bytes than the given length.
+ *
+ * @param handle 1 for stdout, 2 for stderr, file handle from open() for files
+ * @param buf the bytes that should be written
+ * @param len the number of bytes to write
+ * @return Returns the number of bytes that were written. On error, -errno will be returned.
+ */
+static inline long writeFile(long handle, const char *buf, long len) {
+    return syscall3(WRITE_SYSCALL, handle, (long) buf, len);
+}
+
+/**
+ * This is a wrapper function of the close syscall.
+ *
+ * @param fd the file descriptor of the opened file (or directory)
+ * @return Returns zero on success. On error, -errno will be returned.
+ */
+static inline int closeFile(long fd) {
+    return syscall1(CLOSE_SYSCALL, fd);
+}
+
+/**
+ * This function is a wrapper function of the fstat system call.
+ *
+ * @param fd the file descriptor of the opened file (or directory)
+ * @param statBuffer the buffer to store the file stat
+ * @return On success, zero is returned. On error, -errno is returned.
+ */
+static inline int checkFdStat(long fd, struct stat *statBuffer) {
+    return syscall2(FSTAT_SYSCALL, fd, (long) statBuffer);
+}
+
+/**
+ * This function is a wrapper function of the mmap system call.
+ *
+ * @param size the number of bytes to map
+ * @param prot the memory protection of the mapping
+ * @param flags the flags of the mapping (i.e. MAP_SHARED)
+ * @param fd the file descriptor to map, or -1 for the anonymous memory
+ * @param offset the offset in the file
+ * @return On success, the address of the mapped memory is returned. On error, -errno will be returned.
+ */
+static inline long mapRegion(long size, long prot, long flags, long fd, long offset) {
+    return syscall6(MMAP_SYSCALL, 0, size, prot, flags, fd, offset);
+}
+
+/**
+ * This function maps the private anonymous memory (readable and writable).
+ *
+ * @param size the number of bytes to map
+ * @return On success, the address of the mapped memory is returned. On error, -errno will be returned.
+ */
+static inline long mapMemory(long size) {
+    return mapRegion(size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+/**
+ * This function is a wrapper function of the munmap system call.
+ *
+ * @param addr the address of the mapped memory
+ * @param size the number of bytes to unmap
+ * @return On success, zero is returned. On error, -errno will be returned.
+ */
+static inline int unmapMemory(char *addr, long size) {
+    return syscall2(MUNMAP_SYSCALL, (long) addr, size);
+}
+
+/**
+ * This function checks if the file with the given name exists and could be read, by using the access syscall.
+ *
+ * @param fileName the name of the file to check if it exists
+ * @return If the file exists, returns 0. Otherwise, returns -errno.
+ */
+static inline int accessToFile(const char *fileName) {
+    return syscall2(ACCESS_SYSCALL, (long) fileName, R_OK);
+}
+
+/**
+ * This is a wrapper function of the exit_group syscall, which terminates every thread of the process.
+ *
+ * @param exitCode the exit code
+ */
+static inline void exitProcess(int exitCode) {
+    syscall1(EXIT_GROUP_SYSCALL, exitCode);
+    __builtin_unreachable();
+}
+
+#ifdef FREESTANDING
+/*
+ * The freestanding build (-DFREESTANDING -nostdlib -static), which links neither the libc nor its startup code,
+ * so the process starts at the _start below, and there is no dynamic loader, relocation or libc initialisation.
+ * The compiler still emits the calls to the memcpy(), the memmove(), the memset(), the memcmp() and the strlen()
+ * (i.e. for the struct copies and the loops that it recognises), so they are defined here.
+ */
+
+/*
+ * The entry point of the process. The kernel leaves the argc at the top of the stack, followed by the argv
+ * (terminated by NULL) and the envp (terminated by NULL), so the envp starts at the argv + argc + 1.
+ * The main() is called with the 16-byte aligned stack, and its return value is the exit code of the process.
+ */
+asm(".text\n\t"
+    ".globl _start\n\t"
+    ".type _start, @function\n"
+    "_start:\n\t"
+    "xorl %ebp, %ebp\n\t"             //the outermost frame
+    "movq (%rsp), %rdi\n\t"           //argc
+    "leaq 8(%rsp), %rsi\n\t"          //argv
+    "leaq 16(%rsp, %rdi, 8), %rdx\n\t" //envp
+    "andq $-16, %rsp\n\t"
+    "call main\n\t"
+    "movl %eax, %edi\n\t"
+    "movl $231, %eax\n\t"             //EXIT_GROUP_SYSCALL
+    "syscall\n\t"
+    "hlt\n\t"
+    ".size _start, . - _start");
+
+/**
+ * This function copies the bytes with the rep movsb instruction (fast on the cpus with ERMS).
+ *
+ * @param dest the destination
+ * @param src the source, which does not overlap the destination
+ * @param n the number of bytes
+ * @return the destination
+ */
+void *memcpy(void *dest, const void *src, unsigned long n) {
+    void *ret = dest;
+
+    asm volatile("rep movsb"
+        : "+D"(dest), "+S"(src), "+c"(n)
+        :
+        : "memory");
+
+    return ret;
+}
+
+/**
+ * This function copies the bytes, which could overlap. If the destination is after the source,
+ * the bytes are copied backwards (with the direction flag set).
+ *
+ * @param dest the destination
+ * @param src the source
+ * @param n the number of bytes
+ * @return the destination
+ */
+void *memmove(void *dest, const void *src, unsigned long n) {
+    if ((unsigned long) ((char *) dest - (char *) src) >= n) { //no overlap that the forward copy would break
+        return memcpy(dest, src, n);
+    }
+
+    void *ret = dest;
+    char *d = (char *) dest + n - 1;
+    const char *s = (const char *) src + n - 1;
+
+    asm volatile("std\n\t"
+        "rep movsb\n\t"
+        "cld"
+        : "+D"(d), "+S"(s), "+c"(n)
+        :
+        : "memory");
+
+    return ret;
+}
+
+/**
+ * This function fills the bytes with the rep stosb instruction.
+ *
+ * @param dest the destination
+ * @param c the byte to fill
+ * @param n the number of bytes
+ * @return the destination
+ */
+void *memset(void *dest, int c, unsigned long n) {
+    void *ret = dest;
+
+    asm volatile("rep stosb"
+        : "+D"(dest), "+c"(n)
+        : "a"(c)
+        : "memory");
+
+    return ret;
+}
+
+/**
+ * This function compares the bytes (as unsigned), just like the memcmp of the libc.
+ *
+ * @param s1 the first bytes
+ * @param s2 the second bytes
+ * @param n the number of bytes
+ * @return 0 if they are the same, a negative value if the first bytes are smaller, or a positive value
+ */
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+int memcmp(const void *s1, const void *s2, unsigned long n) {
+    const unsigned char *p1 = s1;
+    const unsigned char *p2 = s2;
+
+    for (unsigned long i = 0; i < n; i++) {
+        if (p1[i] != p2[i]) {
+            return p1[i] - p2[i];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * This function counts the bytes of the string. The loop is not turned into a call to itself.
+ *
+ * @param str the string
+ * @return the length of the string
+ */
+__attribute__((optimize("no-tree-loop-distribute-patterns")))
+unsigned long strlen(const char *str) {
+    unsigned long i = 0;
+
+    while (str[i] != '\0') {
+        i++;
+    }
+
+    return i;
+}
+#endif
+
+#endif